@@ -1,11 +1,17 @@
 #include <string>
+#include <fstream>
+#include <sstream>
+#include <cmath>
 
 #include "position.hh"
 #include "engine.hh"
+#include "thread_pool.hh"
+#include "perf_counters.hh"
+#include "init.hh"
 
 
 // bench positions from Stockfish
-const std::vector<std::string> fens = {
+const std::vector<std::string> default_fens = {
   "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
   "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
   "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
@@ -64,28 +70,437 @@ const std::vector<std::string> fens = {
 };
 
 
-int main(int argc, char* argv[]) {
-    Engine engine;
+struct BenchResult {
+    std::string fen;
+    uint64_t nodes;
+    double time; // milliseconds
+    int depth;
+    Move best_move;
+};
+
+struct BenchRun {
+    std::vector<BenchResult> results;
+    uint64_t nodes = 0;
+    int time = 0; // milliseconds
+    uint64_t eval_probes = 0;
+    uint64_t eval_hits = 0;
+#ifdef SEARCH_STATS
+    SearchStats stats;
+#endif
+
+    double nps() {
+        return 1000.0 * nodes / std::max(1, time);
+    }
+};
+
+// one fen per line, blank lines and lines starting with # are skipped
+static std::vector<std::string> read_positions(std::string path) {
+    std::vector<std::string> fens;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line[0] != '#') {
+            fens.push_back(line);
+        }
+    }
+    return fens;
+}
+
+static BenchRun run_bench(ThreadPool& threads, std::vector<std::string>& fens, SearchInfo info, bool print_fens) {
+    BenchRun run;
     Position position;
-    
-    SearchInfo info;
-    info.fixed_depth = true;
-    info.depth = 13;
-    if (argc > 1)  info.depth = std::stoi(argv[1]);
 
-    int nodes = 0;
     auto start_time = std::chrono::high_resolution_clock::now();
     for (auto fen : fens) {
-        printf("%s\n", fen.c_str());
-        engine.init();
+        if (print_fens) {
+            printf("%s\n", fen.c_str());
+        }
+        threads.clear();
         position.set_fen(fen);
-        engine.get_move(position, info);
-        nodes += engine.total_nodes;
+
+        auto search_start = std::chrono::high_resolution_clock::now();
+        threads.start_thinking(position, info);
+        threads.wait_for_search_finished();
+        auto search_end = std::chrono::high_resolution_clock::now();
+
+        BenchResult result;
+        result.fen = fen;
+        result.nodes = threads.nodes_searched();
+        result.time = std::chrono::duration<double, std::milli>(search_end - search_start).count();
+        result.depth = threads.main()->engine->completed_depth;
+        result.best_move = threads.best_move;
+        run.results.push_back(result);
+
+        run.nodes += result.nodes;
+        for (auto& th : threads.threads) {
+            run.eval_probes += th->engine->eval_cache.probes;
+            run.eval_hits += th->engine->eval_cache.hits;
+            STAT(run.stats.add(th->engine->stats));
+        }
     }
     auto end_time = std::chrono::high_resolution_clock::now();
-    int time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+    run.time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+
+    return run;
+}
+
+static double mean(std::vector<double>& values) {
+    double sum = 0;
+    for (double v : values) sum += v;
+    return values.empty() ? 0 : sum / values.size();
+}
+
+// sample variance
+static double variance(std::vector<double>& values) {
+    if (values.size() < 2) {
+        return 0;
+    }
+    double m = mean(values);
+    double sum = 0;
+    for (double v : values) sum += (v - m) * (v - m);
+    return sum / (values.size() - 1);
+}
+
+// continued fraction for the regularized incomplete beta function (numerical recipes)
+static double beta_continued_fraction(double a, double b, double x) {
+    constexpr double eps = 1e-12;
+    constexpr double tiny = 1e-300;
+
+    double c = 1;
+    double d = 1 - (a + b) * x / (a + 1);
+    d = 1 / (std::abs(d) < tiny ? tiny : d);
+    double h = d;
+    for (int m = 1; m <= 300; m++) {
+        double aa = m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m));
+        d = 1 + aa * d;
+        c = 1 + aa / c;
+        d = 1 / (std::abs(d) < tiny ? tiny : d);
+        c = std::abs(c) < tiny ? tiny : c;
+        h *= d * c;
+
+        aa = -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1));
+        d = 1 + aa * d;
+        c = 1 + aa / c;
+        d = 1 / (std::abs(d) < tiny ? tiny : d);
+        c = std::abs(c) < tiny ? tiny : c;
+        double delta = d * c;
+        h *= delta;
+        if (std::abs(delta - 1) < eps) {
+            break;
+        }
+    }
+    return h;
+}
+
+static double incomplete_beta(double a, double b, double x) {
+    if (x <= 0) return 0;
+    if (x >= 1) return 1;
+
+    double front = std::exp(std::lgamma(a + b) - std::lgamma(a) - std::lgamma(b) + a * std::log(x) + b * std::log(1 - x));
+    if (x < (a + 1) / (a + b + 2)) {
+        return front * beta_continued_fraction(a, b, x) / a;
+    }
+    return 1 - front * beta_continued_fraction(b, a, 1 - x) / b;
+}
+
+// P(T <= t) for student's t distribution with df degrees of freedom
+static double student_t_cdf(double t, double df) {
+    double tail = 0.5 * incomplete_beta(df / 2, 0.5, df / (df + t * t));
+    return t > 0 ? 1 - tail : tail;
+}
+
+// minimal readers for the json bench writes, not a general parser
+static bool json_number(const std::string& text, std::string key, double& value) {
+    size_t pos = text.find("\"" + key + "\":");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    const char* start = text.c_str() + pos + key.size() + 3;
+    char* end;
+    value = std::strtod(start, &end);
+    return end != start;
+}
+
+static std::vector<double> json_array(const std::string& text, std::string key) {
+    std::vector<double> values;
+    size_t pos = text.find("\"" + key + "\":");
+    if (pos == std::string::npos) {
+        return values;
+    }
+    std::istringstream ss(text.substr(text.find('[', pos) + 1, text.find(']', pos) - text.find('[', pos) - 1));
+    std::string value;
+    while (std::getline(ss, value, ',')) {
+        values.push_back(std::stod(value));
+    }
+    return values;
+}
 
-    printf("\ntime: %f\n", (float) time_taken / 1000);
-    printf("nodes: %d\n", nodes);
-    printf("nps: %f M\n\n", (float) nodes / (time_taken * 1000));
+struct Baseline {
+    double depth = 0, threads = 0, hash = 0;
+    std::vector<uint64_t> nodes; // per position
+    std::vector<double> nps_runs;
+};
+
+static bool read_baseline(std::string path, Baseline& baseline) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    json_number(text, "depth", baseline.depth);
+    json_number(text, "threads", baseline.threads);
+    json_number(text, "hash", baseline.hash);
+
+    size_t positions_start = text.find("\"positions\":");
+    size_t positions_end = text.find(']', positions_start);
+    if (positions_start == std::string::npos || positions_end == std::string::npos) {
+        return false;
+    }
+    std::string positions = text.substr(positions_start, positions_end - positions_start);
+    for (size_t pos = positions.find("\"nodes\":"); pos != std::string::npos; pos = positions.find("\"nodes\":", pos + 1)) {
+        baseline.nodes.push_back(std::strtoull(positions.c_str() + pos + 8, nullptr, 10));
+    }
+
+    // baselines from a single bench run only have the total nps
+    baseline.nps_runs = json_array(text, "nps_runs");
+    double nps;
+    if (baseline.nps_runs.empty() && json_number(text.substr(positions_end), "nps", nps)) {
+        baseline.nps_runs.push_back(nps);
+    }
+    return !baseline.nps_runs.empty();
+}
+
+static void write_json(FILE* out, std::vector<BenchRun>& runs, int depth, int num_threads, int hash) {
+    BenchRun& first = runs[0];
+    std::vector<double> nps_runs;
+    for (BenchRun& run : runs) {
+        nps_runs.push_back(run.nps());
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"depth\": %d,\n", depth);
+    fprintf(out, "  \"threads\": %d,\n", num_threads);
+    fprintf(out, "  \"hash\": %d,\n", hash);
+    fprintf(out, "  \"positions\": [\n");
+    for (size_t i = 0; i < first.results.size(); i++) {
+        BenchResult& r = first.results[i];
+        fprintf(out, "    {\"fen\": \"%s\", \"nodes\": %llu, \"time_ms\": %.3f, \"depth\": %d, \"best_move\": \"%s\", \"nps\": %.0f}%s\n",
+            r.fen.c_str(), r.nodes, r.time, r.depth, r.best_move.to_uci().c_str(),
+            r.time > 0 ? 1000 * r.nodes / r.time : 0.0, i + 1 < first.results.size() ? "," : "");
+    }
+    fprintf(out, "  ],\n");
+    fprintf(out, "  \"nodes\": %llu,\n", first.nodes);
+    fprintf(out, "  \"time_ms\": %d,\n", first.time);
+    fprintf(out, "  \"nps\": %.0f,\n", mean(nps_runs));
+    fprintf(out, "  \"nps_runs\": [");
+    for (size_t i = 0; i < nps_runs.size(); i++) {
+        fprintf(out, "%s%.0f", i ? ", " : "", nps_runs[i]);
+    }
+    fprintf(out, "],\n");
+
+    // lazy smp node counts depend on thread timing, so only one thread gives a reproducible signature
+    if (num_threads == 1) {
+        fprintf(out, "  \"signature\": %llu\n", first.nodes);
+    } else {
+        fprintf(out, "  \"signature\": null\n");
+    }
+    fprintf(out, "}\n");
+}
+
+static bool save_json(std::string path, std::vector<BenchRun>& runs, int depth, int num_threads, int hash) {
+    FILE* out = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (!out) {
+        printf("Error: cannot write %s\n", path.c_str());
+        return false;
+    }
+    write_json(out, runs, depth, num_threads, hash);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return true;
+}
+
+// runs the bench several times and checks nps against a baseline with a one-sided welch t-test.
+// returns 1 if the slowdown is significant
+static int compare(Baseline& baseline, std::vector<BenchRun>& runs, int depth, int num_threads, int hash) {
+    if (baseline.depth != depth || baseline.threads != num_threads || baseline.hash != hash) {
+        printf("warning: baseline was run with depth %d, %d threads, %d mb hash\n",
+            int(baseline.depth), int(baseline.threads), int(baseline.hash));
+    }
+
+    // node counts only change with the search, so they separate functional changes from speed
+    BenchRun& first = runs[0];
+    int changed = 0;
+    for (size_t i = 0; i < first.results.size(); i++) {
+        if (i >= baseline.nodes.size() || baseline.nodes[i] != first.results[i].nodes) {
+            changed++;
+        }
+    }
+    if (changed || baseline.nodes.size() != first.results.size()) {
+        printf("node counts: %d of %zu positions differ from the baseline (functional change)\n",
+            changed, first.results.size());
+    } else {
+        printf("node counts: identical to the baseline\n");
+    }
+
+    std::vector<double> nps_runs;
+    for (BenchRun& run : runs) {
+        nps_runs.push_back(run.nps());
+    }
+
+    double base_mean = mean(baseline.nps_runs);
+    double base_var = variance(baseline.nps_runs);
+    double new_mean = mean(nps_runs);
+    double new_var = variance(nps_runs);
+    double change = 100 * (new_mean - base_mean) / base_mean;
+
+    printf("baseline nps: %.0f +- %.0f (%zu runs)\n", base_mean, std::sqrt(base_var), baseline.nps_runs.size());
+    printf("current nps:  %.0f +- %.0f (%zu runs)\n", new_mean, std::sqrt(new_var), nps_runs.size());
+    printf("change: %+.2f%%\n", change);
+
+    double se2 = base_var / baseline.nps_runs.size() + new_var / nps_runs.size();
+    if (se2 <= 0) {
+        printf("not enough runs to estimate noise, use -runs 2 or more\n");
+        return 0;
+    }
+
+    // welch-satterthwaite degrees of freedom. a single-run baseline only contributes its mean
+    double df = se2 * se2;
+    double denom = 0;
+    if (baseline.nps_runs.size() > 1) {
+        denom += std::pow(base_var / baseline.nps_runs.size(), 2) / (baseline.nps_runs.size() - 1);
+    }
+    if (nps_runs.size() > 1) {
+        denom += std::pow(new_var / nps_runs.size(), 2) / (nps_runs.size() - 1);
+    }
+    df /= denom;
+
+    double t = (new_mean - base_mean) / std::sqrt(se2);
+    double p = student_t_cdf(t, df);
+    printf("welch t: %.3f, df: %.1f, p(slower): %.4f\n", t, df, p);
+
+    constexpr double alpha = 0.05;
+    if (p < alpha) {
+        printf("FAIL: nps dropped %.2f%%, beyond run-to-run noise\n", -change);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    init_all();
+
+    SearchInfo info;
+    info.fixed_depth = true;
+    info.depth = 13;
+
+    // bench [depth] [-threads n] [-hash mb] [-file positions] [-json out.json] [-perf]
+    // bench compare <baseline.json> [-runs n] [-save out.json] [same options]
+    int num_threads = 1;
+    int hash = Engine::Hash;
+    std::string positions_file;
+    std::string json_file;
+    bool perf = false;
+
+    bool compare_mode = false;
+    std::string baseline_file;
+    int num_runs = 5;
+
+    int first_arg = 1;
+    if (argc > 2 && std::string(argv[1]) == "compare") {
+        compare_mode = true;
+        baseline_file = argv[2];
+        first_arg = 3;
+    }
+
+    for (int i = first_arg; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-perf") perf = true;
+        else if (arg == "-threads" && i + 1 < argc) num_threads = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "-hash" && i + 1 < argc) hash = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "-file" && i + 1 < argc) positions_file = argv[++i];
+        else if ((arg == "-json" || arg == "-save") && i + 1 < argc) json_file = argv[++i];
+        else if (arg == "-runs" && i + 1 < argc) num_runs = std::max(1, std::stoi(argv[++i]));
+        else info.depth = std::stoi(arg);
+    }
+
+    std::vector<std::string> fens = positions_file.empty() ? default_fens : read_positions(positions_file);
+    if (fens.empty()) {
+        printf("Error: no positions in %s\n", positions_file.c_str());
+        return 1;
+    }
+
+    Baseline baseline;
+    if (compare_mode && !read_baseline(baseline_file, baseline)) {
+        printf("Error: cannot read baseline %s\n", baseline_file.c_str());
+        return 1;
+    }
+
+    if (hash != Engine::Hash) {
+        Engine::shared_transposition_table().resize(hash);
+    }
+
+    ThreadPool threads;
+    threads.set(num_threads);
+
+    if (compare_mode) {
+        std::vector<BenchRun> runs;
+        for (int i = 0; i < num_runs; i++) {
+            runs.push_back(run_bench(threads, fens, info, false));
+            printf("run %d: %.0f nps\n", i + 1, runs.back().nps());
+            fflush(stdout);
+        }
+        printf("\n");
+
+        int result = compare(baseline, runs, info.depth, num_threads, hash);
+        if (!json_file.empty() && !save_json(json_file, runs, info.depth, num_threads, hash)) {
+            return 1;
+        }
+        return result;
+    }
+
+    // opened before the search so the cost of opening isn't counted
+    std::unique_ptr<PerfCounters> counters;
+    if (perf) {
+        counters = std::make_unique<PerfCounters>();
+    }
+
+#ifdef SEARCH_PROFILE
+    Profiler::start();
+#endif
+    if (counters) counters->start();
+    std::vector<BenchRun> runs = {run_bench(threads, fens, info, true)};
+    if (counters) counters->stop();
+#ifdef SEARCH_PROFILE
+    Profiler::stop();
+#endif
+    BenchRun& run = runs[0];
+
+    printf("\nattacks: %s, %zu kb of tables\n", SLIDER_INDEXING, attack_table_bytes() / 1024);
+    printf("time: %f\n", (float) run.time / 1000);
+    printf("nodes: %llu\n", run.nodes);
+    printf("nps: %f M\n", run.nps() / 1000000);
+    printf("eval cache hit rate: %.1f%%\n", run.eval_probes ? 100.0 * run.eval_hits / run.eval_probes : 0.0);
+    if (num_threads == 1) {
+        printf("signature: %llu\n", run.nodes);
+    }
+    printf("\n");
+    if (counters) {
+        counters->print(run.nodes);
+        printf("\n");
+    }
+    STAT(run.stats.print());
+#ifdef SEARCH_PROFILE
+    Profiler::print();
+    printf("\n");
+#endif
+
+    if (!json_file.empty() && !save_json(json_file, runs, info.depth, num_threads, hash)) {
+        return 1;
+    }
 }
\ No newline at end of file
@@ -1,5 +1,11 @@
 #include "bitboards.hh"
 
+#include <cstdio>
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
 // for debugging
 void print_bitboard(uint64_t bitboard) {
     for (int i = 0; i < 64; i++) {
@@ -11,275 +17,111 @@ void print_bitboard(uint64_t bitboard) {
     printf("\n\n");
 }
 
-// given a mask, generate all possible subsets of occupancy
-std::vector<uint64_t> get_all_subsets(uint64_t mask) {
-    std::vector<int> bit_positions;
-    for (int i = 0; i < 64; i++) {
-        if (mask & (1ULL << i)) {
-            bit_positions.push_back(i);
-        }
-    }
-
-    std::vector<uint64_t> variations;
-    for (int subset = 0; subset < (1 << bit_positions.size()); subset++) {
-        uint64_t occupancy = 0ULL;
-        for (int i = 0; i < bit_positions.size(); i++) {
-            if (subset & (1 << i)) {
-                occupancy |= (1ULL << bit_positions[i]);
-            }
-        }
-        variations.push_back(occupancy);
-    }
-    return variations;
-}
-
-// get rook attack mask excluding edges and not considering blocking
-uint64_t get_rook_mask(int square) {
-    uint64_t mask = 0ULL;
-    int row = square / 8;
-    int col = square % 8;
-
-    // horizontal
-    for (int i = col - 1; i >= 1; i--) {
-        mask |= square_bb(row * 8 + i);
-    }
-    for (int i = col + 1; i <= 6; i++) {
-        mask |= square_bb(row * 8 + i);
-    }
-
-    // vertical
-    for (int i = row - 1; i >= 1; i--) {
-        mask |= square_bb(i * 8 + col);
-    }
-    for (int i = row + 1; i <= 6; i++) {
-        mask |= square_bb(i * 8 + col);
-    }
 
-    return mask;
-}
+// all tables below are computed by the compiler, so there is no startup cost
+// and they are shared read-only pages between processes
 
-// generate bitboard of attacked squares given position of rook and board occupancy
-uint64_t get_rook_attacks(int square, uint64_t occupancy) {
-    uint64_t attacks = 0ULL;
-    int row = square / 8;
-    int col = square % 8;
+#ifdef USE_PEXT
+static constexpr bool USE_PEXT_INDEX = true;
+#else
+static constexpr bool USE_PEXT_INDEX = false;
+#endif
 
-    // left
-    for (int i = col - 1; i >= 0; i--) {
-        uint64_t bb = square_bb(row * 8 + i);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
-        }
-    }
-    // right
-    for (int i = col + 1; i < 8; i++) {
-        uint64_t bb = square_bb(row * 8 + i);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
-        }
-    }
-    // up
-    for (int i = row - 1; i >= 0; i--) {
-        uint64_t bb = square_bb(i * 8 + col);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
-        }
-    }
-    // down
-    for (int i = row + 1; i < 8; i++) {
-        uint64_t bb = square_bb(i * 8 + col);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
-        }
+// edges of the board can be excluded in occupancy because the piece must stop there.
+// each square gets exactly 2 ^ (blockers in its mask) slots of one shared array, from 2 ^ 5
+// for a bishop in the corner to 2 ^ 12 for a rook in the corner
+struct SliderSquare {
+    // row and column (or diagonals), excluding edges
+    uint64_t mask;
+    uint64_t magic;
+    uint32_t offset;
+    uint32_t shift;
+};
+
+template<int Size>
+struct SliderTable {
+    SliderSquare squares[64];
+    // moves given square and board occupancy
+    uint64_t moves[Size];
+};
+
+static constexpr int slider_table_size(bool rook) {
+    int size = 0;
+    for (int square = 0; square < 64; square++) {
+        size += 1 << popcount(rook ? get_rook_mask(square) : get_bishop_mask(square));
     }
-
-    return attacks;
+    return size;
 }
 
+static constexpr int ROOK_TABLE_SIZE = slider_table_size(true);     // 102400
+static constexpr int BISHOP_TABLE_SIZE = slider_table_size(false);  // 5248
 
-// same for bishops:
+struct LeaperTable {
+    uint64_t pawn_attacks[64][2];
+    uint64_t knight_moves[64];
+    uint64_t king_moves[64];
+};
 
-uint64_t get_bishop_mask(int square) {
-    uint64_t mask = 0ULL;
-    int row = square / 8;
-    int col = square % 8;
+struct LineTable {
+    uint64_t check_blocks[64][64];
+    uint64_t line_bb[64][64];
+};
 
-    // top right
-    for (int r = row + 1, c = col + 1; r < 7 && c < 7; r++, c++) {
-        mask |= square_bb(r * 8 + c);
-    }
-    // top left
-    for (int r = row + 1, c = col - 1; r < 7 && c > 0; r++, c--) {
-        mask |= square_bb(r * 8 + c);
-    }
-    // bottom right
-    for (int r = row - 1, c = col + 1; r > 0 && c < 7; r--, c++) {
-        mask |= square_bb(r * 8 + c);
-    }
-    // bottom left
-    for (int r = row - 1, c = col - 1; r > 0 && c > 0; r--, c--) {
-        mask |= square_bb(r * 8 + c);
-    }
-
-    return mask;
-}
-
-uint64_t get_bishop_attacks(int square, uint64_t occupancy) {
-    uint64_t attacks = 0ULL;
+template<int Size>
+static constexpr SliderTable<Size> make_slider_table(bool rook, const uint64_t (&magics)[64]) {
+    SliderTable<Size> table = {};
+    uint32_t offset = 0;
+    for (int square = 0; square < 64; square++) {
+        uint64_t mask = rook ? get_rook_mask(square) : get_bishop_mask(square);
+        uint32_t shift = 64 - popcount(mask);
+        table.squares[square] = {mask, magics[square], offset, shift};
+
+        // walk every subset of the mask (carry-rippler). subsets come out in the order
+        // of their packed bits, so the n-th subset is the one pext maps to n
+        uint64_t occ = 0ULL;
+        uint64_t n = 0;
+        do {
+            uint64_t index = USE_PEXT_INDEX ? n : (occ * magics[square]) >> shift;
+            table.moves[offset + index] = rook ? get_rook_attacks(square, occ) : get_bishop_attacks(square, occ);
+            occ = (occ - mask) & mask;
+            n++;
+        } while (occ);
+        offset += n;
+    }
+    return table;
+}
+
+static constexpr uint64_t step_moves(int square, const int (&dirs)[8][2]) {
     int row = square / 8;
     int col = square % 8;
 
-    // top right
-    for (int r = row + 1, c = col + 1; r < 8 && c < 8; r++, c++) {
-        uint64_t bb = square_bb(r * 8 + c);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
+    uint64_t moves = 0ULL;
+    for (auto& d : dirs) {
+        int new_row = row + d[0];
+        int new_col = col + d[1];
+        if (new_row >= 0 && new_row < 8 && new_col >= 0 && new_col < 8) {
+            moves |= square_bb(new_row * 8 + new_col);
         }
     }
-    // top left
-    for (int r = row + 1, c = col - 1; r < 8 && c >= 0; r++, c--) {
-        uint64_t bb = square_bb(r * 8 + c);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
-        }
-    }
-    // bottom right
-    for (int r = row - 1, c = col + 1; r >= 0 && c < 8; r--, c++) {
-        uint64_t bb = square_bb(r * 8 + c);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
-        }
-    }
-    // bottom left
-    for (int r = row - 1, c = col - 1; r >= 0 && c >= 0; r--, c--) {
-        uint64_t bb = square_bb(r * 8 + c);
-        attacks |= bb;
-        if (occupancy & bb) {
-            break;
-        }
-    }
-
-    return attacks;
-}
-
-
-static uint64_t random_U64() {
-    std::random_device rd;
-    std::mt19937_64 gen(rd());
-    std::uniform_int_distribution<uint64_t> dist(0, ~0ULL);
-    return dist(gen);
-}
-
-// generate perfect hash function for occupancies to rook/bishop attack index through brute force
-// values are hard-coded into main code
-static uint64_t find_magic_number(int square, bool rook) {
-    int relevant_bits; // max relevant bits that can block attacks
-    uint64_t mask;
-    if (rook) {
-        mask = get_rook_mask(square);
-        relevant_bits = 12;
-    } else {
-        // bishop
-        mask = get_bishop_mask(square);
-        relevant_bits = 9;
-    }
-
-    std::vector<uint64_t> occupancies = get_all_subsets(mask);
-    std::unordered_map<uint64_t, uint64_t> attack_table;
-
-    while (true) {
-        uint64_t magic = random_U64() & random_U64() & random_U64(); // sparse
-            
-        bool found = true;
-        attack_table.clear();
-
-        for (uint64_t o : occupancies) {
-            uint64_t index = (o * magic) >> (64 - relevant_bits);
-            uint64_t attacks = rook ? get_rook_attacks(square, o) : get_bishop_attacks(square, o);
-
-            if (attack_table.count(index) && attack_table[index] != attacks) {
-                found = false;
-                break;
-            } else {
-                attack_table[index] = attacks;
-            }
-        }
-
-        if (found) {
-            return magic;
-        }
-    }
-}
-
-/*
-Ex:
-int main() {
-    printf("rook:\n");
-    for (int square = 0; square < 64; square++) {
-        if (square % 4 == 0) printf("\n");
-        printf("0x%llx, ", find_magic_number(square, true));
-    }
-
-    printf("\n\nbishop:\n");
-    for (int square = 0; square < 64; square++) {
-        if (square % 4 == 0) printf("\n");
-        printf("0x%llx, ", find_magic_number(square, false));
-    }
-
-    return 0;
+    return moves;
 }
-*/
-
-
-// row and column mask by square, excluding edges
-uint64_t rook_masks[64];
-// precompute rook moves given square and board occupancy.
-// edges of the board can be excluded in occupancy because the rook must stop there.
-// this gives a max of 12 possible blockers per rook position. 2 ^ 12 = 4096.
-uint64_t rook_moves[64][4096];
-
-// similar for bishops
-uint64_t bishop_masks[64];
-uint64_t bishop_moves[64][512];
 
-// precomputed moves for each square
-uint64_t pawn_attacks[64][2];
-uint64_t knight_moves[64];
-uint64_t king_moves[64];
-
-uint64_t check_blocks[64][64];
-uint64_t line_bb[64][64];
-
-void init_bitboards() {
-    std::vector<std::tuple<int ,int>> knight_dirs = {
+static constexpr LeaperTable make_leaper_table() {
+    constexpr int knight_dirs[8][2] = {
         {2,1}, {2,-1}, {-2,1}, {-2,-1}, {1,2}, {1,-2}, {-1,2}, {-1,-2}
     };
-    std::vector<std::tuple<int ,int>> king_dirs = {
+    constexpr int king_dirs[8][2] = {
         {1,0}, {-1,0}, {0,1}, {0,-1}, {1,1}, {-1,-1}, {1,-1}, {-1,1}
     };
 
+    LeaperTable table = {};
     for (int square = 0; square < 64; square++) {
         int row = square / 8;
         int col = square % 8;
 
-        // knight moves
-        uint64_t moves = 0ULL;
-        for (auto d : knight_dirs) {
-            int new_row = row + std::get<0>(d);
-            int new_col = col + std::get<1>(d);
-            if (new_row >= 0 && new_row < 8 && new_col >= 0 && new_col < 8) {
-                moves |= square_bb(new_row * 8 + new_col);
-            }
-        }
-        knight_moves[square] = moves;
-        
+        table.knight_moves[square] = step_moves(square, knight_dirs);
+        table.king_moves[square] = step_moves(square, king_dirs);
+
         // pawn attacks
         uint64_t white_attacks = 0ULL;
         uint64_t black_attacks = 0ULL;
@@ -299,98 +141,85 @@ void init_bitboards() {
                 black_attacks |= square_bb((row + 1) * 8 + (col + 1));
             }
         }
-        pawn_attacks[square][WHITE] = white_attacks;
-        pawn_attacks[square][BLACK] = black_attacks;
-
-        // king moves
-        moves = 0ULL;
-        for (auto d : king_dirs) {
-            int new_row = row + std::get<0>(d);
-            int new_col = col + std::get<1>(d);
-            if (new_row >= 0 && new_row < 8 && new_col >= 0 && new_col < 8) {
-                moves |= square_bb(new_row * 8 + new_col);
-            }
-        }
-        king_moves[square] = moves;
-
-        // rook moves
-        rook_masks[square] = get_rook_mask(square);
-        std::vector<uint64_t> occupancies = get_all_subsets(rook_masks[square]);
-        for (uint64_t occ : occupancies) {
-            uint64_t index = (occ * rook_magic_numbers[square]) >> (64 - 12);
-            rook_moves[square][index] = get_rook_attacks(square, occ);
-        }
-
-        // bishop moves
-        bishop_masks[square] = get_bishop_mask(square);
-        occupancies = get_all_subsets(bishop_masks[square]);
-        for (uint64_t occ : occupancies) {
-            uint64_t index = (occ * bishop_magic_numbers[square]) >> (64 - 9);
-            bishop_moves[square][index] = get_bishop_attacks(square, occ);
-        }
+        table.pawn_attacks[square][WHITE] = white_attacks;
+        table.pawn_attacks[square][BLACK] = black_attacks;
     }
+    return table;
+}
 
-    // check blocks and line bitboards
+static constexpr LineTable make_line_table() {
+    LineTable table = {};
     for (int s1 = 0; s1 < 64; s1++) {
         for (int s2 = 0; s2 < 64; s2++) {
-            if (get_bishop_moves(s1, 0ULL) & square_bb(s2)) {
-                check_blocks[s1][s2] = get_bishop_moves(s1, square_bb(s2)) &
-                                       get_bishop_moves(s2, square_bb(s1));
-
-                line_bb[s1][s2] = (get_bishop_moves(s1, 0ULL) & get_bishop_moves(s2, 0ULL))
-                                  | square_bb(s1) | square_bb(s2);
-            } else if (get_rook_moves(s1, 0ULL) & square_bb(s2)) {
-                check_blocks[s1][s2] = get_rook_moves(s1, square_bb(s2)) &
-                                       get_rook_moves(s2, square_bb(s1));
-
-                line_bb[s1][s2] = (get_rook_moves(s1, 0ULL) & get_rook_moves(s2, 0ULL))
-                                  | square_bb(s1) | square_bb(s2);
-            } else {
-                check_blocks[s1][s2] = 0ULL;
-                line_bb[s1][s2] = 0ULL;
+            if (get_bishop_attacks(s1, 0ULL) & square_bb(s2)) {
+                table.check_blocks[s1][s2] = get_bishop_attacks(s1, square_bb(s2)) &
+                                             get_bishop_attacks(s2, square_bb(s1));
+
+                table.line_bb[s1][s2] = (get_bishop_attacks(s1, 0ULL) & get_bishop_attacks(s2, 0ULL))
+                                        | square_bb(s1) | square_bb(s2);
+            } else if (get_rook_attacks(s1, 0ULL) & square_bb(s2)) {
+                table.check_blocks[s1][s2] = get_rook_attacks(s1, square_bb(s2)) &
+                                             get_rook_attacks(s2, square_bb(s1));
+
+                table.line_bb[s1][s2] = (get_rook_attacks(s1, 0ULL) & get_rook_attacks(s2, 0ULL))
+                                        | square_bb(s1) | square_bb(s2);
             }
 
             // capture the checker
-            check_blocks[s1][s2] |= square_bb(s2);
+            table.check_blocks[s1][s2] |= square_bb(s2);
         }
     }
+    return table;
 }
 
+static constexpr SliderTable<ROOK_TABLE_SIZE> rook_table = make_slider_table<ROOK_TABLE_SIZE>(true, rook_magic_numbers);
+static constexpr SliderTable<BISHOP_TABLE_SIZE> bishop_table = make_slider_table<BISHOP_TABLE_SIZE>(false, bishop_magic_numbers);
+static constexpr LeaperTable leaper_table = make_leaper_table();
+static constexpr LineTable line_table = make_line_table();
+
 
 // for square1 in check by square2, gives the squares that could block or capture the checker
 uint64_t get_check_blocks(int s1, int s2) {
-    return check_blocks[s1][s2];
+    return line_table.check_blocks[s1][s2];
 }
 
 uint64_t get_line_bb(int s1, int s2) {
-    return line_bb[s1][s2];
+    return line_table.line_bb[s1][s2];
 }
 
 
 uint64_t get_pawn_attacks(int square, int color) {
-    return pawn_attacks[square][color];
+    return leaper_table.pawn_attacks[square][color];
 }
 
 uint64_t get_knight_moves(int square) {
-    return knight_moves[square];
+    return leaper_table.knight_moves[square];
 }
 
 uint64_t get_king_moves(int square) {
-    return king_moves[square];
+    return leaper_table.king_moves[square];
+}
+
+static inline uint64_t slider_index(const SliderSquare& s, uint64_t blockers) {
+#ifdef USE_PEXT
+    return s.offset + _pext_u64(blockers, s.mask);
+#else
+    return s.offset + (((blockers & s.mask) * s.magic) >> s.shift);
+#endif
 }
 
 uint64_t get_bishop_moves(int square, uint64_t blockers) {
-    blockers &= bishop_masks[square];
-    uint64_t index = (blockers * bishop_magic_numbers[square]) >> (64 - 9);
-    return bishop_moves[square][index];
+    return bishop_table.moves[slider_index(bishop_table.squares[square], blockers)];
 }
 
 uint64_t get_rook_moves(int square, uint64_t blockers) {
-    blockers &= rook_masks[square];
-    uint64_t index = (blockers * rook_magic_numbers[square]) >> (64 - 12);
-    return rook_moves[square][index];
+    return rook_table.moves[slider_index(rook_table.squares[square], blockers)];
 }
 
 uint64_t get_queen_moves(int square, uint64_t blockers) {
     return get_bishop_moves(square, blockers) | get_rook_moves(square, blockers);
-}
\ No newline at end of file
+}
+
+size_t attack_table_bytes() {
+    return sizeof(rook_table) + sizeof(bishop_table) + sizeof(leaper_table) + sizeof(line_table);
+}
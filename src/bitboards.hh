@@ -2,10 +2,7 @@
 #define bitboards_hh
 
 #include <vector>
-#include <tuple>
 #include <cstdint>
-#include <random>
-#include <unordered_map>
 
 #include "types.hh"
 
@@ -21,46 +18,46 @@ inline uint64_t pop_lsb(uint64_t& bitboard) {
     return square;
 }
 
-inline uint64_t square_bb(int square) {
+constexpr uint64_t square_bb(int square) {
     return 1ULL << square;
 }
 
 constexpr uint64_t rook_magic_numbers[64] = {
-    0x80002030400880, 0x200108020184120, 0x4210010600200010, 0x100026100291000, 
-    0x1000a0100880010, 0x2180010200040480, 0x200010284080200, 0x4800c2080005300, 
-    0x800040005430, 0x80444a440410040, 0x1070110400400850, 0x5000803000024830, 
-    0x2005400400230002, 0x202010100083012, 0x21006a0400508b80, 0x210101082004861, 
-    0x202408800804402, 0x8800201004140010, 0x5404860108084210, 0x602181800081000, 
-    0x220200082400, 0x8010120821080801, 0x280302504004200, 0x804020810a00140, 
-    0x12200050c001a241, 0x402848084000, 0x800106802c018, 0x1804041404004232, 
-    0x42000108004009, 0x11308004040021c0, 0x82008010004060, 0x7000012008004016, 
-    0x20504200088004, 0x240002002040280, 0x2824050041600008, 0x24440100100, 
-    0x5808000200220104, 0x40800800a0082060, 0x800460000808104, 0x1000080420042, 
-    0x40c00921108000, 0x8002204408400408, 0x300402800060200, 0x500460010828002, 
-    0x4a20081081082002, 0x2900802001a2400, 0x104118108a510004, 0x304c18410880100, 
-    0x2c88041000402020, 0xb00140300200820, 0x9020a300840020, 0x82103000201a, 
-    0x8103008040581001, 0xa04000451880100, 0x1290010a004020, 0x10002010206010, 
-    0x4b401300802206, 0x300182051004001, 0x910140820010841, 0x1c620302940240a, 
-    0x402005020081d02, 0x2000880400024081, 0x2002441840201, 0x840446441040286
+    0x1480021120400080, 0x44000900a2000c1, 0x2080088020001000, 0x100100004201900, 
+    0x3200102008140200, 0x2100110028840002, 0x80060009000380, 0x2500010001218042, 
+    0xc02800082400028, 0x2000802000804000, 0x101802008821000, 0x8000801000080080, 
+    0x9001102480004, 0x6000409509200, 0x28040014050a1008, 0x204800500044080, 
+    0x806a8000804000, 0x1040010022854302, 0x100888020001000, 0x21d8010100100020, 
+    0x8018004000880, 0x1010008024400, 0x2000040002180190, 0x1091460000804401, 
+    0x4c0024080002089, 0xa087008100400060, 0x182410100200018, 0x401002100081000, 
+    0x220a080080040080, 0x10600c200081004, 0x4000100400014a98, 0x469000100029046, 
+    0x80052000400041, 0x809008021004004, 0x200080801000, 0x40000a00220011c0, 
+    0x801400800800, 0xc1800200800400, 0x40e600040200b108, 0x21040b2000104, 
+    0x21204000818000, 0x21000a000404000, 0x3006600041010010, 0x100100822020040, 
+    0x10400880080802c, 0x3802040002008080, 0x80061890040041, 0x30000402c0820001, 
+    0x4000204080110900, 0x4000d000200bc0, 0x2000820141902200, 0x90041000a4090100, 
+    0x80820800040080, 0x1081040080020080, 0x1042800100420080, 0x40047108600, 
+    0x1052014408001, 0x1104a082400011, 0x44200040481101, 0x805000910000421, 
+    0x806000420089002, 0x4600030c100806, 0x90610080084, 0x690218021040242
 };
 
 constexpr uint64_t bishop_magic_numbers[64] = {
-    0x8000aa0400801002, 0x8846081404002, 0x6009984040020203, 0x13004044000000, 
-    0x100a089002d00000, 0x1008444020200008, 0x8880090080a004, 0xd05444c0200221, 
-    0x14200440400, 0xa00022008610, 0x4810b0010128021, 0x1020008a02020005, 
-    0x8080800400, 0xe00640482400e448, 0x8020a4082000, 0x2c0100c40a1040, 
-    0x8403a124008200, 0x6ac21060481008, 0x2000404804500840, 0x212088800800800, 
-    0x10100098201010, 0x200030c300121, 0x3012080400120908, 0x8842413b20240402, 
-    0x2c40200001004400, 0x440041400026a0f2, 0x381004030a01210, 0x8001080001004101, 
-    0x400100901100c000, 0x3248030424809040, 0x2a020404090282, 0x804c0220410780, 
-    0x2000184242240400, 0x22088104028524, 0xa000804060040009, 0x82120084080080, 
-    0x9004080200002008, 0xc800268842002080, 0x840400030212, 0x200c03020000510, 
-    0x8060084a0008801, 0x84040c4232000, 0x8008090606010400, 0x20018140c008802, 
-    0x80223040408400, 0x827220051100a120, 0x86024c0040400894, 0x8800261024080080, 
-    0x2010280073804000, 0x100402015080000, 0xc0001040101014c2, 0x3000104010040008, 
-    0x84500008f820400, 0x81806089000, 0x42000424a0201, 0x4009082000c0400, 
-    0x40242200e0130940, 0x4098008801, 0xa408202001000, 0x10026008a4040, 
-    0x100648210b10051, 0x141101002009, 0x51aac43202200, 0x14003243012200
+    0x242a481000820040, 0x12004810208202b, 0x11004084142000c, 0x80a02a0500110, 
+    0x110404200b040080, 0x4022014420028040, 0x409141012082041, 0x210404a10100200, 
+    0x442200a04110402, 0x20200302120041, 0xa0300080850000, 0x800110c04800270, 
+    0x50060210200a00, 0x200000901018008c, 0x1600005508484004, 0x14a0084050801, 
+    0x2200b5604244800, 0x880221120c0048, 0x404100808001410, 0x2008000286004081, 
+    0x2003000820080010, 0x882804808040209, 0x100188c100202, 0xa00184a008440, 
+    0x50500800500a1000, 0x82100404d0218222, 0x1800280010004040, 0x1222008008048032, 
+    0x21010000104008, 0x4188020000229401, 0x48020101050504, 0x4004008081025100, 
+    0xe842c2094404304, 0x14010408299000, 0xa80804040820, 0x204008201a0200, 
+    0x240008020020220, 0x10a10100020098, 0x2001080200111300, 0x300a038020010c00, 
+    0x2101004008ac2, 0x9862121001000, 0x1010a02028015000, 0x4408202018000100, 
+    0x4000400102100100, 0x10012a0081042a01, 0x220120408400108, 0x404280041008440, 
+    0x208041228a000, 0x101e220202200440, 0x20402084104002, 0x100020060a80021, 
+    0x400a00a540000, 0x1040102001210200, 0x4002044502204a, 0x9048028084110100, 
+    0x10500610108c024, 0x4310102900500, 0x46000900880400, 0x2000004420200, 
+    0x2480420010860200, 0x40024104080080, 0x340601801080284, 0x110024088020040
 };
 
 constexpr uint64_t RANK_1 = 0xff00000000000000;
@@ -73,9 +70,153 @@ constexpr uint64_t RANK_7 = 0xff00;
 constexpr uint64_t RANK_8 = 0xff;
 
 
+// get rook attack mask excluding edges and not considering blocking
+constexpr uint64_t get_rook_mask(int square) {
+    uint64_t mask = 0ULL;
+    int row = square / 8;
+    int col = square % 8;
+
+    // horizontal
+    for (int i = col - 1; i >= 1; i--) {
+        mask |= square_bb(row * 8 + i);
+    }
+    for (int i = col + 1; i <= 6; i++) {
+        mask |= square_bb(row * 8 + i);
+    }
+
+    // vertical
+    for (int i = row - 1; i >= 1; i--) {
+        mask |= square_bb(i * 8 + col);
+    }
+    for (int i = row + 1; i <= 6; i++) {
+        mask |= square_bb(i * 8 + col);
+    }
+
+    return mask;
+}
+
+// generate bitboard of attacked squares given position of rook and board occupancy.
+// slow, only used to build the lookup tables
+constexpr uint64_t get_rook_attacks(int square, uint64_t occupancy) {
+    uint64_t attacks = 0ULL;
+    int row = square / 8;
+    int col = square % 8;
+
+    // left
+    for (int i = col - 1; i >= 0; i--) {
+        uint64_t bb = square_bb(row * 8 + i);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+    // right
+    for (int i = col + 1; i < 8; i++) {
+        uint64_t bb = square_bb(row * 8 + i);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+    // up
+    for (int i = row - 1; i >= 0; i--) {
+        uint64_t bb = square_bb(i * 8 + col);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+    // down
+    for (int i = row + 1; i < 8; i++) {
+        uint64_t bb = square_bb(i * 8 + col);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+
+    return attacks;
+}
+
+
+// same for bishops:
+
+constexpr uint64_t get_bishop_mask(int square) {
+    uint64_t mask = 0ULL;
+    int row = square / 8;
+    int col = square % 8;
+
+    // top right
+    for (int r = row + 1, c = col + 1; r < 7 && c < 7; r++, c++) {
+        mask |= square_bb(r * 8 + c);
+    }
+    // top left
+    for (int r = row + 1, c = col - 1; r < 7 && c > 0; r++, c--) {
+        mask |= square_bb(r * 8 + c);
+    }
+    // bottom right
+    for (int r = row - 1, c = col + 1; r > 0 && c < 7; r--, c++) {
+        mask |= square_bb(r * 8 + c);
+    }
+    // bottom left
+    for (int r = row - 1, c = col - 1; r > 0 && c > 0; r--, c--) {
+        mask |= square_bb(r * 8 + c);
+    }
+
+    return mask;
+}
+
+constexpr uint64_t get_bishop_attacks(int square, uint64_t occupancy) {
+    uint64_t attacks = 0ULL;
+    int row = square / 8;
+    int col = square % 8;
+
+    // top right
+    for (int r = row + 1, c = col + 1; r < 8 && c < 8; r++, c++) {
+        uint64_t bb = square_bb(r * 8 + c);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+    // top left
+    for (int r = row + 1, c = col - 1; r < 8 && c >= 0; r++, c--) {
+        uint64_t bb = square_bb(r * 8 + c);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+    // bottom right
+    for (int r = row - 1, c = col + 1; r >= 0 && c < 8; r--, c++) {
+        uint64_t bb = square_bb(r * 8 + c);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+    // bottom left
+    for (int r = row - 1, c = col - 1; r >= 0 && c >= 0; r--, c--) {
+        uint64_t bb = square_bb(r * 8 + c);
+        attacks |= bb;
+        if (occupancy & bb) {
+            break;
+        }
+    }
+
+    return attacks;
+}
+
+
 void print_bitboard(uint64_t bitboard);
 
-void init_bitboards();
+// sliding piece attacks are indexed by magic multiplication, or with make PEXT=1 by
+// the bmi2 pext instruction (fast on intel haswell+ and amd zen 3+, microcoded on older amd)
+#ifdef USE_PEXT
+constexpr const char* SLIDER_INDEXING = "pext";
+#else
+constexpr const char* SLIDER_INDEXING = "magic";
+#endif
 
 uint64_t get_check_blocks(int s1, int s2);
 uint64_t get_line_bb(int s1, int s2);
@@ -87,4 +228,7 @@ uint64_t get_bishop_moves(int square, uint64_t blockers);
 uint64_t get_rook_moves(int square, uint64_t blockers);
 uint64_t get_queen_moves(int square, uint64_t blockers);
 
+// memory used by all the attack and line tables
+size_t attack_table_bytes();
+
 #endif
\ No newline at end of file
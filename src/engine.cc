@@ -1,11 +1,15 @@
 #include "engine.hh"
 #include "polyglot.hh"
 
-Engine::Engine() : transposition_table(Hash) {
-    NNUE::init();
+Engine::Engine(TranspositionTable& table) : transposition_table(table), eval_cache(EvalCacheSize) {
     init();
 }
 
+TranspositionTable& Engine::shared_transposition_table() {
+    static TranspositionTable table(Hash);
+    return table;
+}
+
 static inline bool is_mate_score(int val) {
     return std::abs(val) >= MATE_SCORE - MAX_DEPTH;
 }
@@ -27,11 +31,18 @@ void Engine::clean_accumulators(int ply) {
 }
 
 int Engine::evaluation(Position& position) {
+    PROFILE_SCOPE(EVAL);
+    int val;
+    if (eval_cache.get(position.pos_key(), val)) {
+        return val;
+    }
+
     clean_accumulators(acc_index);
-    int val = NNUE::evaluate_incremental(accumulators[acc_index], position.turn);
+    val = NNUE::evaluate_incremental(accumulators[acc_index], position.turn);
     val = std::max(val, -MATE_SCORE);
     val = std::min(val, MATE_SCORE);
 
+    eval_cache.insert(position.pos_key(), (int16_t) val);
     return val;
 }
 
@@ -43,6 +54,7 @@ int Engine::get_corrhist_adjustment(Position& position) {
 }
 
 void Engine::make_move(Position& position, Move move, int ply) {    
+    PROFILE_SCOPE(MAKE_MOVE);
     total_nodes++;
     stack[ply].move = move;
 
@@ -65,6 +77,7 @@ void Engine::make_move(Position& position, Move move, int ply) {
 }
 
 void Engine::unmake_move(Position& position) {
+    PROFILE_SCOPE(MAKE_MOVE);
     position.pop();
     acc_index--;
 }
@@ -72,19 +85,12 @@ void Engine::unmake_move(Position& position) {
 // shorter search at the end of negamax to only evaluate quiet positions
 int Engine::quiescense(Position& position, int alpha, int beta, int current_depth) {
     bool pv_node = beta > alpha + 1;
+    STAT(stats.qsearch_nodes++);
 
     if (position.get_draw()) {
         return 0;
     }
 
-    TerminalState terminal_state = position.get_terminal_state();
-    if (terminal_state) {
-        if (terminal_state != STALEMATE) {
-            return -MATE_SCORE + current_depth;
-        }
-        return 0;
-    }
-
     Move hash_move;
     TTEntry tt;
     bool transposition_found = transposition_table.get(position.pos_key(), tt);
@@ -97,7 +103,7 @@ int Engine::quiescense(Position& position, int alpha, int beta, int current_dept
         }
     }
 
-    if (transposition_found && !pv_node && tt.depth != TT_DEPTH_UNSEARCHED && position.fifty_move_count() < 90) {
+    if (transposition_found && !pv_node && position.fifty_move_count() < 90) {
         if (tt.value >= MATE_SCORE - MAX_DEPTH) {
             tt.value -= current_depth;
         } else if (tt.value <= -MATE_SCORE + MAX_DEPTH) {
@@ -107,6 +113,7 @@ int Engine::quiescense(Position& position, int alpha, int beta, int current_dept
         if (tt.type == EXACT_BOUND ||
            (tt.type == UPPER_BOUND && tt.value <= alpha) ||
            (tt.type == LOWER_BOUND && tt.value >= beta)) {
+            STAT(stats.qsearch_tt_cutoffs++);
             return tt.value;
         }
     }
@@ -117,17 +124,6 @@ int Engine::quiescense(Position& position, int alpha, int beta, int current_dept
     if (!in_check) {
         int raw_eval = transposition_found ? tt.static_eval : evaluation(position);
         static_eval = raw_eval + get_corrhist_adjustment(position);
-
-        if (!transposition_found) {
-            transposition_table.insert(
-                position.pos_key(),
-                (int16_t) raw_eval,
-                (int16_t) raw_eval,
-                0,
-                EXACT_BOUND,
-                TT_DEPTH_UNSEARCHED
-            );
-        }
     }
 
     int local_max = static_eval;
@@ -145,17 +141,16 @@ int Engine::quiescense(Position& position, int alpha, int beta, int current_dept
     
     alpha = std::max(alpha, local_max);
 
+    // in check the picker searches all evasions, quiet ones included
     bool tt_tactic = position.piece_on(hash_move.to()) || hash_move.promote_to();
-    MovePicker move_picker(position, *this, current_depth, tt_tactic ? hash_move : Move(), true);
+    MovePicker move_picker(position, *this, current_depth, (tt_tactic || in_check) ? hash_move : Move(), true);
+    int move_num = 0;
     while (true) {
         Move move = move_picker.next_move();
         if (!move) {
             break;
         }
-
-        if (!is_legal(position, move)) {
-            continue;
-        }
+        move_num++;
 
         // SEE pruning
         if (!in_check && move_picker.stage == STAGE_BAD_TACTICS) {
@@ -182,19 +177,42 @@ int Engine::quiescense(Position& position, int alpha, int beta, int current_dept
         }
     }
 
+    // mate and stalemate fall out of the move loop: in check every evasion was tried,
+    // otherwise only a position without tactics needs the full legal move test
+    if (!move_num) {
+        if (in_check) {
+            return -MATE_SCORE + current_depth;
+        }
+        if (no_legal_moves(position)) {
+            return 0;
+        }
+    }
+
     return alpha;
 }
 
 
+// the shared count is only read every few thousand nodes, or exactly at the limit with one thread
+bool Engine::node_limit_reached() {
+    if (total_nodes < limits.next_node_check) {
+        return false;
+    }
+
+    uint64_t searched = nodes_searched();
+    if (searched >= limits.nodes) {
+        return true;
+    }
+
+    limits.next_node_check = total_nodes + std::min<uint64_t>(4096, limits.nodes - searched);
+    return false;
+}
+
+
 // negamax search with alpha beta pruning
 int Engine::negamax(Position& position, int remaining_depth, int current_depth, int alpha, int beta, Move exclude_move) {
-    if (total_nodes % 16 == 0) {
-        if ((limits.search_time && get_milli_duration(limits.start_time) >= limits.search_time)
-            || (limits.nodes && total_nodes >= limits.nodes)
-            || (limits.stop_search && limits.stop_search->load())) {
-            
-            return INF;
-        }
+    // the time limit is enforced by the timer thread setting the stop flag
+    if (limits.stop_search->load(std::memory_order_relaxed) || (limits.nodes && node_limit_reached())) {
+        return INF;
     }
 
     bool root_node = current_depth == 0;
@@ -230,7 +248,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
     if (transposition_found && tt.best_move) {
         hash_move = Move(tt.best_move);
         // careful of hash collisions
-        if (!is_pseudo_legal(position, hash_move)) {
+        if (!is_pseudo_legal(position, hash_move) || !is_legal(position, hash_move)) {
             transposition_found = false;
             hash_move = Move();
         }
@@ -247,6 +265,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
 
         if (tt.type == EXACT_BOUND || (tt.type == UPPER_BOUND && tt.value <= alpha) ||
            (tt.type == LOWER_BOUND && tt.value >= beta)) {
+            STAT(stats.tt_cutoffs++);
             return tt.value;
         }
     }
@@ -261,10 +280,9 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
         static_eval = raw_eval;
         if (!exclude_move) {
             static_eval += get_corrhist_adjustment(position);
-            if (tt.depth != TT_DEPTH_UNSEARCHED &&
-               (tt.type == EXACT_BOUND ||
+            if (tt.type == EXACT_BOUND ||
                (tt.type == UPPER_BOUND && tt.value < static_eval) ||
-               (tt.type == LOWER_BOUND && tt.value > static_eval))) {
+               (tt.type == LOWER_BOUND && tt.value > static_eval)) {
 
                 eval = tt.value;
             }
@@ -281,18 +299,6 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
         eval = static_eval;
     }
 
-    // cache static eval
-    if (!transposition_found) {
-        transposition_table.insert(
-            position.pos_key(),
-            (int16_t) raw_eval,
-            (int16_t) raw_eval,
-            0,
-            EXACT_BOUND,
-            TT_DEPTH_UNSEARCHED
-        );
-    }
-
     stack[current_depth].static_eval = static_eval;
     // heuristic to make certain pruning more/less aggressive
     bool improving = true;
@@ -303,6 +309,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
     // reverse futility pruning
     if (!in_check && !pv_node && !exclude_move && remaining_depth <= 8 &&
         beta + RFP_SCALE * (remaining_depth - improving) <= eval) {
+        STAT(stats.rfp_prunes++);
         return (eval + 2 * beta) / 3;
     }
 
@@ -322,6 +329,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
             
         // make null move
         total_nodes++;
+        STAT(stats.null_move_searches++);
         stack[current_depth].move = Move();
 
         uint64_t hash = position.pos_key();
@@ -332,7 +340,6 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
         position.state->en_passant_col = -1;
         position.turn = !position.turn;
         position.state->hash_value ^= Zobrist::turn_key;
-        position.state->pinned[position.turn] = position.get_pinned(position.turn);
 
         int R = 4 + remaining_depth / 4;
         int val = -negamax(position, remaining_depth - 1 - R, current_depth + 1, -beta, -beta + 1);
@@ -343,6 +350,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
         position.state->en_passant_col = ep_col;
         
         if (val >= beta) {
+            STAT(stats.null_move_cutoffs++);
             if (is_mate_score(val)) {
                 return beta;
             }
@@ -363,7 +371,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
             break;
         }
 
-        if (move == exclude_move || !is_legal(position, move)) {
+        if (move == exclude_move) {
             continue;
         }
 
@@ -380,6 +388,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
             // late move pruning
             if (move_picker.stage <= STAGE_QUIETS
                 && move_num >= lmp_table[remaining_depth][improving]) {
+                STAT(stats.lmp_prunes++);
                 if (move_picker.stage > STAGE_GOOD_TACTICS) {
                     move_picker.stage = STAGE_BAD_TACTICS;
                     continue;
@@ -395,6 +404,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
             // the position enough to matter
             if (move_picker.stage <= STAGE_QUIETS
                 && static_eval + FP_BASE + FP_SCALE * lmr_depth <= alpha) {
+                STAT(stats.futility_prunes++);
                 if (move_picker.stage > STAGE_GOOD_TACTICS) {
                     move_picker.stage = STAGE_BAD_TACTICS;
                     continue;
@@ -407,6 +417,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
                 int hist = capture_history[move.to()][piece_type][capture_type];
                 if (static_eval + FP_CAP_BASE + FP_CAP_SCALE * remaining_depth +
                     piece_values[capture_type] + hist / 8 <= alpha) {
+                    STAT(stats.capture_futility_prunes++);
                     continue;
                 }
             }
@@ -415,6 +426,7 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
             if (move_picker.stage == STAGE_QUIETS) {
                 int threshold = SEE_PRUNE_SCALE * remaining_depth;
                 if (!position.SEE(move, -threshold)) {
+                    STAT(stats.see_prunes++);
                     continue;
                 }
             }
@@ -432,10 +444,13 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
             int singular_depth = remaining_depth / 2;
             int singular_beta = tt.value - remaining_depth;
             int val = negamax(position, singular_depth, current_depth, singular_beta - 1, singular_beta, hash_move);
+            STAT(stats.singular_searches++);
 
             if (val < singular_beta) {
                 extension = 1;
+                STAT(stats.singular_extensions++);
             } else if (val >= beta && !is_mate_score(val)) {
+                STAT(stats.multicut_cutoffs++);
                 return val;
             }
         }
@@ -456,14 +471,14 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
             }
         }
 
+        if (move_picker.stage == STAGE_GOOD_TACTICS && position.gives_check(move)) {
+            R -= LMR_GIVES_CHECK;
+        }
+
         make_move(position, move, current_depth);
 
         transposition_table.prefetch(position.pos_key());
 
-        if (position.checkers() && (move_picker.stage == STAGE_GOOD_TACTICS)) {
-            R -= LMR_GIVES_CHECK;
-        }
-
         R /= 1024;
         bool reduce_depth = R > 0;
 
@@ -471,7 +486,9 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
         int val = -MATE_SCORE;
         if (reduce_depth) {
             val = -negamax(position, new_depth - R, current_depth + 1, -alpha - 1, -alpha);
+            STAT(stats.lmr_searches++);
             if (val > alpha) {
+                STAT(stats.lmr_researches++);
                 new_depth += val > local_max + 50;
                 new_depth -= val < local_max + 10;
                 val = -negamax(position, new_depth, current_depth + 1, -alpha - 1, -alpha);
@@ -505,6 +522,8 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
         int to_square = move.to();
 
         if (local_max >= beta) {
+            STAT(stats.beta_cutoffs++);
+            STAT(stats.first_move_cutoffs += moves_played == 1);
             if (!capture) {
                 update_quiet_history(quiet_history, from_square, to_square, remaining_depth, true);
                 update_continuation_history(cont_history, current_depth, to_square, piece - 1, remaining_depth, true);
@@ -538,6 +557,15 @@ int Engine::negamax(Position& position, int remaining_depth, int current_depth,
         tt_bound = EXACT_BOUND;
     }
 
+#ifdef SEARCH_STATS
+    if (!exclude_move) {
+        int depth = std::min(remaining_depth, MAX_DEPTH - 1);
+        if (tt_bound == EXACT_BOUND) stats.pv_nodes[depth]++;
+        else if (tt_bound == LOWER_BOUND) stats.cut_nodes[depth]++;
+        else stats.all_nodes[depth]++;
+    }
+#endif
+
     if (!exclude_move) { // not from singular search
         transposition_table.insert(
             position.pos_key(),
@@ -606,11 +634,16 @@ Move Engine::get_move(Position& position, SearchInfo info) {
         info.verbose = true;
     }
 
-    limits.stop_search = info.stop_search;
+    stop_search.store(false);
+    limits.stop_search = info.stop_search ? info.stop_search : &stop_search;
+    limits.pondering = info.ponder ? info.pondering : nullptr;
+    limits.nodes_searched = info.nodes_searched;
 
     std::memset(root_move_nodes, 0, sizeof(root_move_nodes));
     total_nodes = 0;
-    count = 0;
+    completed_depth = 0;
+    STAT(stats.clear());
+    eval_cache.reset_stats();
 
     if (info.use_book && position.half_moves < 10) {
         // Flavio Martin's opening book
@@ -624,6 +657,9 @@ Move Engine::get_move(Position& position, SearchInfo info) {
     NNUE::reset_accumulators(position, accumulators[acc_index]);
 
     int optimal_time = info.time_left / 20 + info.increment / 2;
+    if (info.ponder_enabled) {
+        optimal_time += optimal_time / 4;
+    }
     if (info.timed_game) {
         // save time
         MoveList root_legals;
@@ -647,6 +683,10 @@ Move Engine::get_move(Position& position, SearchInfo info) {
         limits.nodes = info.nodes;
     }
 
+    if (limits.search_time && limits.search_time < INF) {
+        timer.arm(limits.search_time, limits.stop_search, limits.pondering);
+    }
+
     bool move_found = false;
 
     int eval = 0;
@@ -666,6 +706,7 @@ Move Engine::get_move(Position& position, SearchInfo info) {
         }
 
         move_found = true;
+        completed_depth = depth;
         eval = val;
 
         // uci output
@@ -678,8 +719,9 @@ Move Engine::get_move(Position& position, SearchInfo info) {
             } else {
                 score = "cp " + std::to_string(eval);
             }
-            printf("info depth %d nodes %d score %s nps %d time %d pv %s\n",
-                depth, total_nodes, score.c_str(), 1000 * (total_nodes / time_taken),
+            uint64_t nodes = nodes_searched();
+            printf("info depth %d nodes %llu score %s nps %llu time %d pv %s\n",
+                depth, nodes, score.c_str(), 1000 * nodes / time_taken,
                 time_taken, best_move.to_uci().c_str());
             fflush(stdout);
         }
@@ -700,11 +742,15 @@ Move Engine::get_move(Position& position, SearchInfo info) {
         time_scale *= 2.0 - 1.4 * frac_best_nodes;
 
         // save time by not interrupting a search when possible
-        if (info.timed_game && time_taken > optimal_time * time_scale) {
+        bool pondering = limits.pondering && limits.pondering->load();
+        if (info.timed_game && !pondering && timer.elapsed() > optimal_time * time_scale) {
             break;
         }
     }
 
+    timer.disarm();
+    int stop_latency = timer.stop_latency_us();
+
     if (!move_found) {
         MoveList root_legals;
         get_legal_moves(position, &root_legals);
@@ -723,15 +769,46 @@ Move Engine::get_move(Position& position, SearchInfo info) {
         }
         else printf("evaluation: %d\n", eval);
 
-        printf("nodes: %d\n", total_nodes);
-        printf("nps: %f M\n\n", (float) total_nodes / (time_taken * 1000));
-        printf("count: %d\n\n", count);
+        uint64_t nodes = nodes_searched();
+        printf("nodes: %llu\n", nodes);
+        printf("nps: %f M\n", (double) nodes / (time_taken * 1000));
+        printf("eval cache hit rate: %.1f%%\n", 100 * eval_cache.hit_rate());
+        if (stop_latency >= 0) {
+            printf("stop latency: %d us\n", stop_latency);
+        }
+        printf("\n");
+#ifdef SEARCH_STATS
+        stats.print();
+        printf("\n");
+#endif
     }
 
     return best_move;
 }
 
 
+// expected reply to the move, from the transposition table
+Move Engine::get_ponder_move(Position& position, Move move) {
+    if (!move) {
+        return Move();
+    }
+
+    position.make_move(move);
+
+    Move ponder_move;
+    TTEntry tt;
+    if (transposition_table.get(position.pos_key(), tt) && tt.best_move) {
+        Move candidate(tt.best_move);
+        if (is_pseudo_legal(position, candidate) && is_legal(position, candidate)) {
+            ponder_move = candidate;
+        }
+    }
+
+    position.pop();
+    return ponder_move;
+}
+
+
 void Engine::init() {
     std::memset(quiet_history, 0, sizeof(quiet_history));
     std::memset(capture_history, 0, sizeof(capture_history));
@@ -744,4 +821,5 @@ void Engine::init() {
     init_lmr_table();
 
     transposition_table.clear();
+    eval_cache.clear();
 }
\ No newline at end of file
@@ -11,25 +11,45 @@
 
 #include "nnue/nnue.hh"
 #include "transposition_table.hh"
+#include "eval_cache.hh"
 #include "move.hh"
 #include "position.hh"
 #include "history.hh"
 #include "movepick.hh"
 #include "types.hh"
+#include "timer.hh"
+#include "search_stats.hh"
 
 class Engine {
 public:
     Move best_move;
+    int completed_depth = 0;
 
     struct SearchLimits {
         time_point start_time;
         int search_time = 0;
-        int nodes = 0;
+        uint64_t nodes = 0;
+
+        // own node count at which the shared count is read again
+        uint64_t next_node_check = 0;
+        std::function<uint64_t()> nodes_searched;
         std::atomic<bool>* stop_search = nullptr;
+        std::atomic<bool>* pondering = nullptr;
     } limits;
 
+    // sets the stop flag at the hard time limit
+    Timer timer;
+
+    // used when the caller doesn't provide a stop flag
+    std::atomic<bool> stop_search = false;
+
+    // one table is shared by every search thread
     static constexpr int Hash = 16;
-    TranspositionTable transposition_table;
+    static TranspositionTable& shared_transposition_table();
+    TranspositionTable& transposition_table;
+
+    static constexpr int EvalCacheSize = 2;
+    EvalCache eval_cache;
 
     struct SearchStack {
         int static_eval;
@@ -38,7 +58,7 @@ public:
     SearchStack stack[MAX_DEPTH];
 
     // used in tm
-    int root_move_nodes[64][64];
+    uint64_t root_move_nodes[64][64];
     Move current_root_move;
 
     NNUE::Accumulator accumulators[MAX_DEPTH];
@@ -75,7 +95,7 @@ public:
         }
     }
     
-    Engine();
+    Engine(TranspositionTable& table = shared_transposition_table());
     void init();
 
     void clean_accumulators(int ply);
@@ -89,10 +109,20 @@ public:
     int negamax(Position& position, int remaining_depth, int current_depth, int alpha, int beta, Move exclude_move = Move());
     int aspiration_window(Position& position, int remaining_depth, int estimate);
     Move get_move(Position& position, SearchInfo info = SearchInfo());
+    Move get_ponder_move(Position& position, Move move);
 
     // info for analysis/debugging
-    int total_nodes = 0;
-    int count = 0;
+    NodeCounter total_nodes;
+#ifdef SEARCH_STATS
+    SearchStats stats;
+#endif
+
+    // nodes searched by all threads
+    uint64_t nodes_searched() {
+        return limits.nodes_searched ? limits.nodes_searched() : total_nodes;
+    }
+
+    bool node_limit_reached();
 
     // tunable search parameters
     int RFP_SCALE = 70;
@@ -0,0 +1,77 @@
+#ifndef eval_cache_hh
+#define eval_cache_hh
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// direct-mapped cache of raw nnue evaluations. kept separate from the transposition table
+// so eval-only entries don't take up room needed for search results.
+// each entry packs the upper 48 bits of the key with the 16 bit eval into one word
+class EvalCache {
+    uint64_t* table = nullptr;
+    size_t size = 0;
+
+public:
+    // for reporting hit rate
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+
+    EvalCache(size_t megabytes) {
+        resize(megabytes);
+    }
+
+    ~EvalCache() {
+        if (table) {
+            free(table);
+        }
+    }
+
+    bool get(uint64_t key, int& eval) {
+        probes++;
+        uint64_t entry = table[key & (size - 1)];
+        if ((entry ^ key) >> 16) {
+            return false;
+        }
+
+        hits++;
+        eval = int16_t(entry & 0xFFFF);
+        return true;
+    }
+
+    void insert(uint64_t key, int16_t eval) {
+        table[key & (size - 1)] = (key & ~0xFFFFULL) | uint16_t(eval);
+    }
+
+    float hit_rate() {
+        return probes ? float(hits) / float(probes) : 0;
+    }
+
+    void reset_stats() {
+        probes = 0;
+        hits = 0;
+    }
+
+    void clear() {
+        std::memset(table, 0, size * sizeof(uint64_t));
+        reset_stats();
+    }
+
+    void resize(int megabytes) {
+        if (table) {
+            free(table);
+        }
+
+        // round down to a power of two so the index is a mask
+        size_t entries = size_t(megabytes) * 1024 * 1024 / sizeof(uint64_t);
+        size = 1;
+        while (size * 2 <= entries) {
+            size *= 2;
+        }
+
+        table = (uint64_t *) malloc(size * sizeof(uint64_t));
+        clear();
+    }
+};
+
+#endif
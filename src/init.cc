@@ -0,0 +1,14 @@
+#include "init.hh"
+
+#include <mutex>
+
+#include "zobrist.hh"
+#include "nnue/nnue.hh"
+
+void init_all() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        Zobrist::init();
+        NNUE::init();
+    });
+}
@@ -0,0 +1,10 @@
+#ifndef init_hh
+#define init_hh
+
+// builds the process-wide tables: zobrist keys and the nnue weights.
+// attack tables need nothing here, bitboards.cc has them computed at compile time.
+// every main calls this before constructing a Position or starting a search.
+// thread-safe, and calls after the first return immediately
+void init_all();
+
+#endif
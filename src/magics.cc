@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <unordered_map>
+
+#include "bitboards.hh"
+
+// offline generator for the magic numbers hard-coded in bitboards.hh: magics > numbers.txt
+
+static uint64_t random_U64() {
+    static std::mt19937_64 gen(std::random_device{}());
+    return gen();
+}
+
+// given a mask, generate all possible subsets of occupancy
+static std::vector<uint64_t> get_all_subsets(uint64_t mask) {
+    std::vector<uint64_t> variations;
+    uint64_t occupancy = 0ULL;
+    do {
+        variations.push_back(occupancy);
+        occupancy = (occupancy - mask) & mask;
+    } while (occupancy);
+    return variations;
+}
+
+// generate perfect hash function for occupancies to rook/bishop attack index through brute force
+static uint64_t find_magic_number(int square, bool rook) {
+    // one table slot per blocker subset, so each square's table is as small as it can be
+    uint64_t mask = rook ? get_rook_mask(square) : get_bishop_mask(square);
+    int relevant_bits = popcount(mask);
+
+    std::vector<uint64_t> occupancies = get_all_subsets(mask);
+    std::unordered_map<uint64_t, uint64_t> attack_table;
+
+    while (true) {
+        uint64_t magic = random_U64() & random_U64() & random_U64(); // sparse
+
+        bool found = true;
+        attack_table.clear();
+
+        for (uint64_t o : occupancies) {
+            uint64_t index = (o * magic) >> (64 - relevant_bits);
+            uint64_t attacks = rook ? get_rook_attacks(square, o) : get_bishop_attacks(square, o);
+
+            if (attack_table.count(index) && attack_table[index] != attacks) {
+                found = false;
+                break;
+            } else {
+                attack_table[index] = attacks;
+            }
+        }
+
+        if (found) {
+            return magic;
+        }
+    }
+}
+
+int main() {
+    printf("rook:\n");
+    for (int square = 0; square < 64; square++) {
+        if (square % 4 == 0) printf("\n");
+        printf("0x%llx, ", find_magic_number(square, true));
+    }
+
+    printf("\n\nbishop:\n");
+    for (int square = 0; square < 64; square++) {
+        if (square % 4 == 0) printf("\n");
+        printf("0x%llx, ", find_magic_number(square, false));
+    }
+    printf("\n");
+
+    return 0;
+}
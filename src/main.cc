@@ -11,6 +11,7 @@
 #include "movegen.hh"
 #include "move.hh"
 #include "engine.hh"
+#include "init.hh"
 
 #define FIFO_C_TO_P "cpp_to_python"
 #define FIFO_P_TO_C "python_to_cpp"
@@ -74,6 +75,7 @@ void write_to_pipe(std::string message) {
 
 // run graphics in python. communicate between processes with named pipes
 int main() {
+    init_all();
     std::string playing = "white";
 
     Position position;
@@ -0,0 +1,253 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+#include "move.hh"
+#include "position.hh"
+#include "engine.hh"
+#include "movegen.hh"
+#include "movepick.hh"
+#include "polyglot.hh"
+#include "transposition_table.hh"
+#include "init.hh"
+
+// timings for the primitives under the search: microbench [filter]
+
+// mix of openings, middlegames with checks and captures, and endgames
+const std::vector<std::string> fens = {
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+  "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+  "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+  "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+  "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+  "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+  "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+};
+
+volatile uint64_t sink;
+
+using clock_type = std::chrono::steady_clock;
+
+// runs body until at least target_ns have passed, returns ns per op
+template<typename F>
+static double time_sample(F& body, int ops_per_call, double target_ns, int& calls) {
+    auto start = clock_type::now();
+    double elapsed = 0;
+    int done = 0;
+    while (done < calls || elapsed < target_ns) {
+        body();
+        done++;
+        elapsed = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+    }
+    // later samples use the same number of calls so each measures the same work
+    calls = done;
+    return elapsed / (double(done) * ops_per_call);
+}
+
+// warmup, then 25 samples of about 2 ms. samples further than 3 median absolute deviations
+// from the median (interrupts, frequency changes) are dropped before averaging
+template<typename F>
+static void run(std::string name, std::string& filter, int ops_per_call, F body) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) {
+        return;
+    }
+
+    constexpr int num_samples = 25;
+    int calls = 1;
+    time_sample(body, ops_per_call, 50e6, calls);
+    calls = 1;
+    time_sample(body, ops_per_call, 2e6, calls);
+
+    std::vector<double> samples;
+    for (int i = 0; i < num_samples; i++) {
+        samples.push_back(time_sample(body, ops_per_call, 0, calls));
+    }
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    double median = sorted[num_samples / 2];
+
+    std::vector<double> deviations;
+    for (double s : samples) deviations.push_back(std::abs(s - median));
+    std::sort(deviations.begin(), deviations.end());
+    double mad = deviations[num_samples / 2];
+
+    double sum = 0;
+    int kept = 0;
+    for (double s : samples) {
+        if (std::abs(s - median) <= 3 * mad || mad == 0) {
+            sum += s;
+            kept++;
+        }
+    }
+
+    printf("%-28s %10.2f ns/op   median %10.2f   min %10.2f   (%d/%d samples)\n",
+        name.c_str(), sum / kept, median, sorted[0], kept, num_samples);
+    fflush(stdout);
+}
+
+
+int main(int argc, char* argv[]) {
+    init_all();
+    std::string filter = argc > 1 ? argv[1] : "";
+
+    std::vector<Position> positions;
+    for (auto& fen : fens) {
+        positions.push_back(Position(fen));
+    }
+
+    // move lists per position, generated once so only the measured call is timed
+    std::vector<MoveList> legals(positions.size());
+    std::vector<MoveList> tactics(positions.size());
+    int num_legal = 0, num_tactics = 0;
+    for (size_t i = 0; i < positions.size(); i++) {
+        get_legal_moves(positions[i], &legals[i]);
+        get_moves(positions[i], &tactics[i], GEN_TACTIC);
+        num_legal += legals[i].size;
+        num_tactics += tactics[i].size;
+    }
+    int num_positions = positions.size();
+
+    printf("%d positions, %d legal moves, %d tactics\n\n", num_positions, num_legal, num_tactics);
+
+    const std::pair<MoveGenType, std::string> gen_types[] = {
+        {GEN_ALL, "movegen all"}, {GEN_TACTIC, "movegen tactic"}, {GEN_QUIET, "movegen quiet"}
+    };
+    for (auto& [type, name] : gen_types) {
+        run(name, filter, num_positions, [&] {
+            for (auto& position : positions) {
+                MoveList list;
+                get_moves(position, &list, type);
+                sink = sink + list.size;
+            }
+        });
+    }
+
+    // occupancies of the positions, with every square as the slider's origin
+    run("get_rook_moves", filter, 64 * num_positions, [&] {
+        for (auto& position : positions) {
+            uint64_t occupancy = position.occupancy();
+            for (int square = 0; square < 64; square++) {
+                sink = sink + get_rook_moves(square, occupancy);
+            }
+        }
+    });
+
+    run("get_bishop_moves", filter, 64 * num_positions, [&] {
+        for (auto& position : positions) {
+            uint64_t occupancy = position.occupancy();
+            for (int square = 0; square < 64; square++) {
+                sink = sink + get_bishop_moves(square, occupancy);
+            }
+        }
+    });
+
+    run("get_attackers", filter, 128 * num_positions, [&] {
+        for (auto& position : positions) {
+            uint64_t occupancy = position.occupancy();
+            for (int square = 0; square < 64; square++) {
+                sink = sink + position.get_attackers(square, WHITE, occupancy);
+                sink = sink + position.get_attackers(square, BLACK, occupancy);
+            }
+        }
+    });
+
+    run("is_legal", filter, num_legal, [&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (Move move : legals[i]) {
+                sink = sink + is_legal(positions[i], move);
+            }
+        }
+    });
+
+    run("is_pseudo_legal", filter, num_legal, [&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (Move move : legals[i]) {
+                sink = sink + is_pseudo_legal(positions[i], move);
+            }
+        }
+    });
+
+    run("gives_check", filter, num_legal, [&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (Move move : legals[i]) {
+                sink = sink + positions[i].gives_check(move);
+            }
+        }
+    });
+
+    run("make_move + pop", filter, num_legal, [&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (Move move : legals[i]) {
+                positions[i].make_move(move);
+                positions[i].pop();
+            }
+        }
+    });
+
+    run("SEE", filter, num_tactics, [&] {
+        for (size_t i = 0; i < positions.size(); i++) {
+            for (Move move : tactics[i]) {
+                sink = sink + positions[i].SEE(move);
+            }
+        }
+    });
+
+    run("get_draw", filter, num_positions, [&] {
+        for (auto& position : positions) {
+            sink = sink + position.get_draw();
+        }
+    });
+
+    // random keys spread over a table larger than the caches, like the search
+    TranspositionTable table(Engine::Hash);
+    constexpr int num_keys = 1 << 16;
+    std::vector<uint64_t> keys(num_keys);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (auto& key : keys) {
+        seed ^= seed >> 12;
+        seed ^= seed << 25;
+        seed ^= seed >> 27;
+        key = seed * 2685821657736338717ULL;
+    }
+
+    run("tt insert", filter, num_keys, [&] {
+        for (uint64_t key : keys) {
+            table.insert(key, int16_t(key), int16_t(key >> 16), uint16_t(key >> 32), EXACT_BOUND, int8_t(key & 31));
+        }
+    });
+
+    run("tt get", filter, num_keys, [&] {
+        TTEntry entry;
+        for (uint64_t key : keys) {
+            sink = sink + table.get(key, entry);
+        }
+    });
+
+    auto engine = std::make_unique<Engine>();
+    run("MovePicker::next_move", filter, num_legal, [&] {
+        for (auto& position : positions) {
+            MovePicker picker(position, *engine, 0, Move());
+            while (Move move = picker.next_move()) {
+                sink = sink + move.move;
+            }
+        }
+    });
+
+    if (std::ifstream("titans.bin")) {
+        Position start;
+        run("Polyglot::get_book_move", filter, 1, [&] {
+            sink = sink + Polyglot::get_book_move(start, "titans.bin").move;
+        });
+    } else {
+        printf("Polyglot::get_book_move      skipped: titans.bin not found\n");
+    }
+}
@@ -1,5 +1,17 @@
 #include "movegen.hh"
 
+#include <thread>
+#include <vector>
+#include <atomic>
+
+#include "perft_table.hh"
+
+
+// shifts a bitboard by a signed number of squares
+template<int Offset>
+constexpr uint64_t shift(uint64_t bitboard) {
+    return Offset > 0 ? bitboard << Offset : bitboard >> -Offset;
+}
 
 inline void write_piece_moves(uint64_t moves_bb, int start_square, MoveList* move_list) {
 #if USE_AVX512_VBMI2
@@ -23,14 +35,15 @@ inline void write_piece_moves(uint64_t moves_bb, int start_square, MoveList* mov
 #endif
 }
 
-inline void write_pawn_pushes(uint64_t pawns, int offset, MoveList* move_list) {
+template<int Offset>
+inline void write_pawn_pushes(uint64_t pawns, MoveList* move_list) {
 #if USE_AVX512_VBMI2
     const __m128i from_squares =
         _mm_cvtepi8_epi16(
           _mm512_castsi512_si128(
             _mm512_maskz_compress_epi8(pawns, vec_squares)));
     
-    const __m128i to_squares = _mm_adds_epi16(from_squares, _mm_set1_epi16(offset));
+    const __m128i to_squares = _mm_adds_epi16(from_squares, _mm_set1_epi16(Offset));
     const __m128i moves = _mm_or_si128(_mm_slli_epi16(from_squares, 6), to_squares);
 
     _mm_storeu_si128(reinterpret_cast<__m128i*>(move_list->end()), moves);
@@ -38,46 +51,72 @@ inline void write_pawn_pushes(uint64_t pawns, int offset, MoveList* move_list) {
 #else
     while (pawns) {
         int from_square = pop_lsb(pawns);
-        move_list->add(Move(from_square, from_square + offset));
+        move_list->add(Move(from_square, from_square + Offset));
     }
 #endif
 }
 
 
+template<Color Us>
 inline uint64_t get_castle_moves(Position& position) {
+    // squares for white, black's are 56 lower
+    constexpr int back_rank = Us == WHITE ? 0 : -56;
+    constexpr int kingside = Us == WHITE ? WHITE_KINGSIDE : BLACK_KINGSIDE;
+    constexpr int queenside = Us == WHITE ? WHITE_QUEENSIDE : BLACK_QUEENSIDE;
+    constexpr uint64_t kingside_path = square_bb(61 + back_rank) | square_bb(62 + back_rank);
+    constexpr uint64_t queenside_path = square_bb(59 + back_rank) | square_bb(58 + back_rank) | square_bb(57 + back_rank);
+
     uint64_t moves = 0ULL;
     if (!position.checkers() && position.castle_rights()) {
-        if (position.turn == WHITE) {
-            if ((position.castle_rights() & WHITE_KINGSIDE) &&
-                !position.piece_on(61) && !position.piece_on(62)) {
-                moves |= square_bb(62);
-            }
-            if ((position.castle_rights() & WHITE_QUEENSIDE) &&
-                !position.piece_on(59) && !position.piece_on(58) && !position.piece_on(57)) {
-                moves |= square_bb(58);
-            }
-        } else {
-            if ((position.castle_rights() & BLACK_KINGSIDE) &&
-                !position.piece_on(5) && !position.piece_on(6)) {
-                moves |= square_bb(6);
-            }
-            if ((position.castle_rights() & BLACK_QUEENSIDE) &&
-                !position.piece_on(3) && !position.piece_on(2) && !position.piece_on(1)) {
-                moves |= square_bb(2);
-            }
+        uint64_t occupancy = position.occupancy();
+        if ((position.castle_rights() & kingside) && !(occupancy & kingside_path)) {
+            moves |= square_bb(62 + back_rank);
+        }
+        if ((position.castle_rights() & queenside) && !(occupancy & queenside_path)) {
+            moves |= square_bb(58 + back_rank);
         }
     }
     return moves;
 }
 
-// moves that would be/are legal not considering if they leave the king in check
-void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType move_type) {
-    uint64_t friendly_pieces = position.piece_bb(ALL_PIECES, position.turn);
-    uint64_t opp_pieces = position.piece_bb(ALL_PIECES, !position.turn);
+inline uint64_t get_castle_moves(Position& position) {
+    return position.turn == WHITE ? get_castle_moves<WHITE>(position) : get_castle_moves<BLACK>(position);
+}
+
+// en passant removes two pieces from the capturing rank, so it can uncover a slider
+// that no pin covers. the only checks it can leave in place are from sliders
+static bool is_legal_en_passant(Position& position, int from_square, int to_square) {
+    int king_square = position.king_square(position.turn);
+    int capture_square = (from_square / 8) * 8 + to_square % 8;
+    uint64_t occ = position.occupancy() ^ square_bb(from_square) ^ square_bb(to_square) ^ square_bb(capture_square);
+
+    if ((position.piece_bb(BISHOP, !position.turn) | position.piece_bb(QUEEN, !position.turn)) &
+         get_bishop_moves(king_square, occ)) {
+        return false;
+    }
+    return !((position.piece_bb(ROOK, !position.turn) | position.piece_bb(QUEEN, !position.turn)) &
+              get_rook_moves(king_square, occ));
+}
+
+// legal moves of the given type. pinned pieces stay on their pin ray, the king avoids
+// attacked squares, and en passant is tested for uncovered checks
+template<Color Us>
+static void generate_moves(Position& position, MoveList* move_list, MoveGenType move_type) {
+    constexpr Color them = Us == WHITE ? BLACK : WHITE;
+    // board is indexed from a8, so white moves toward lower squares
+    constexpr int dir = Us == WHITE ? -1 : 1;
+    constexpr uint64_t third_rank = Us == WHITE ? RANK_3 : RANK_6;
+    constexpr uint64_t seventh_rank = Us == WHITE ? RANK_7 : RANK_2;
+    constexpr uint64_t promo_rank = Us == WHITE ? RANK_8 : RANK_1;
+    // from the capture square back to the pawn
+    constexpr int right_diag = Us == WHITE ? 7 : -9;
+    constexpr int left_diag = Us == WHITE ? 9 : -7;
+
+    uint64_t friendly_pieces = position.piece_bb(ALL_PIECES, Us);
+    uint64_t opp_pieces = position.piece_bb(ALL_PIECES, them);
     uint64_t all_pieces = friendly_pieces | opp_pieces;
     uint64_t pinned = position.pinned();
-    int king_square = position.king_square(position.turn);
-    int dir = position.turn == WHITE ? -1 : 1;
+    int king_square = position.king_square(Us);
 
     uint64_t targets = ~friendly_pieces;
     if (move_type == GEN_QUIET) {
@@ -86,9 +125,11 @@ void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType
         targets &= opp_pieces;
     }
 
+    uint64_t danger = position.king_danger();
+
     // if double check, moves must be king evasions
     if (popcount(position.checkers()) > 1) {
-        uint64_t king_moves = get_king_moves(king_square) & targets;
+        uint64_t king_moves = get_king_moves(king_square) & targets & ~danger;
         write_piece_moves(king_moves, king_square, move_list);
         return;
     }
@@ -97,27 +138,21 @@ void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType
     uint64_t check_blocks =
       position.checkers() ? get_check_blocks(king_square, lsb(position.checkers())) : ~0ULL;
 
+    // pawns pinned on the king's file can still push, other pinned pawns can only
+    // capture their pinner and are handled one by one below
+    uint64_t pawns = position.piece_bb(PAWN, Us);
+    uint64_t push_pawns = pawns & (~pinned | (0x0101010101010101ULL << (king_square % 8)));
+    uint64_t capture_pawns = pawns & ~pinned;
+
     // quiet pawn moves
     if (move_type != GEN_TACTIC) {
-        // pushes
-        uint64_t single_push_pawns;
-        uint64_t double_push_pawns;
-        if (position.turn == WHITE) {
-            single_push_pawns = position.piece_bb(PAWN, WHITE) & ~RANK_7 & (~all_pieces << 8);
-            double_push_pawns = single_push_pawns & RANK_2 & (~all_pieces << 16);
-
-            single_push_pawns &= check_blocks << 8;
-            double_push_pawns &= check_blocks << 16;
-        } else {
-            single_push_pawns = position.piece_bb(PAWN, BLACK) & ~RANK_2 & (~all_pieces >> 8);
-            double_push_pawns = single_push_pawns & RANK_7 & (~all_pieces >> 16);
-
-            single_push_pawns &= check_blocks >> 8;
-            double_push_pawns &= check_blocks >> 16;
-        }
+        // pushes, as target squares
+        uint64_t single_pushes = shift<dir * 8>(push_pawns & ~seventh_rank) & ~all_pieces;
+        uint64_t double_pushes = shift<dir * 8>(single_pushes & third_rank) & ~all_pieces & check_blocks;
+        single_pushes &= check_blocks;
 
-        write_pawn_pushes(single_push_pawns, dir * 8, move_list);
-        write_pawn_pushes(double_push_pawns, dir * 16, move_list);
+        write_pawn_pushes<dir * 8>(shift<-dir * 8>(single_pushes), move_list);
+        write_pawn_pushes<dir * 16>(shift<-dir * 16>(double_pushes), move_list);
     }
 
     // tactical pawn moves
@@ -125,25 +160,23 @@ void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType
         // en passant
         int ep_col = position.ep_col();
         if (ep_col >= 0) {
-            int pawn = WHITE_PAWN + 6 * position.turn;
-            int row = 3 + position.turn; // 4 if black
+            constexpr int pawn = WHITE_PAWN + 6 * Us;
+            constexpr int row = 3 + Us; // 4 if black
+            int to_square = (row + dir) * 8 + ep_col;
             int from_square = row * 8 + ep_col - 1;
-            if (ep_col > 0 && position.piece_on(from_square) == pawn) {
-                move_list->add(Move(from_square, (row + dir) * 8 + ep_col));
+            if (ep_col > 0 && position.piece_on(from_square) == pawn &&
+                is_legal_en_passant(position, from_square, to_square)) {
+                move_list->add(Move(from_square, to_square));
             }
             from_square += 2;
-            if (ep_col < 7 && position.piece_on(from_square) == pawn) {
-                move_list->add(Move(from_square, (row + dir) * 8 + ep_col));
+            if (ep_col < 7 && position.piece_on(from_square) == pawn &&
+                is_legal_en_passant(position, from_square, to_square)) {
+                move_list->add(Move(from_square, to_square));
             }
         }
 
         // push promotions
-        uint64_t promo_pawns;
-        if (position.turn == WHITE) {
-            promo_pawns = position.piece_bb(PAWN, WHITE) & RANK_7 & ((~all_pieces & check_blocks) << 8);
-        } else {
-            promo_pawns = position.piece_bb(PAWN, BLACK) & RANK_2 & ((~all_pieces & check_blocks) >> 8);
-        }
+        uint64_t promo_pawns = push_pawns & seventh_rank & shift<-dir * 8>(~all_pieces & check_blocks);
 
         while (promo_pawns) {
             int from_square = pop_lsb(promo_pawns);
@@ -153,23 +186,7 @@ void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType
             }
         }
 
-        uint64_t attacks;
-        uint64_t promo_rank;
-        int right_diag;
-        int left_diag;
-        if (position.turn == WHITE) {
-            // shift up
-            attacks = position.piece_bb(PAWN, WHITE) >> 8;
-            promo_rank = RANK_8;
-            right_diag = 7;
-            left_diag = 9;
-        } else {
-            // shift down
-            attacks = position.piece_bb(PAWN, BLACK) << 8;
-            promo_rank = RANK_1;
-            right_diag = -9;
-            left_diag = -7;
-        }
+        uint64_t attacks = shift<dir * 8>(capture_pawns);
 
         // shift left and right
         uint64_t right_captures = ((attacks & 0x7f7f7f7f7f7f7f7f) << 1) & opp_pieces & check_blocks;
@@ -203,19 +220,37 @@ void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType
                 move_list->add(Move(from_square, to_square, promo));
             }
         }
+
+        // diagonally pinned pawns capturing their pinner
+        uint64_t pinned_pawns = pawns & pinned & ~push_pawns;
+        while (pinned_pawns) {
+            int from_square = pop_lsb(pinned_pawns);
+            uint64_t captures = get_pawn_attacks(from_square, Us) & opp_pieces & check_blocks &
+                                get_line_bb(from_square, king_square);
+            while (captures) {
+                int to_square = pop_lsb(captures);
+                if (square_bb(to_square) & promo_rank) {
+                    for (auto promo : {QUEEN, ROOK, BISHOP, KNIGHT}) {
+                        move_list->add(Move(from_square, to_square, promo));
+                    }
+                } else {
+                    move_list->add(Move(from_square, to_square));
+                }
+            }
+        }
     }
 
     uint64_t piece_targets = targets & check_blocks;
 
     // normal piece moves
-    uint64_t knights = position.piece_bb(KNIGHT, position.turn) & ~pinned;
+    uint64_t knights = position.piece_bb(KNIGHT, Us) & ~pinned;
     while (knights) {
         int from_square = pop_lsb(knights);
         uint64_t moves = get_knight_moves(from_square) & piece_targets;
         write_piece_moves(moves, from_square, move_list);
     }
 
-    uint64_t bishops = position.piece_bb(BISHOP, position.turn) | position.piece_bb(QUEEN, position.turn);
+    uint64_t bishops = position.piece_bb(BISHOP, Us) | position.piece_bb(QUEEN, Us);
     while (bishops) {
         int from_square = pop_lsb(bishops);
         uint64_t moves = get_bishop_moves(from_square, all_pieces) & piece_targets;
@@ -225,7 +260,7 @@ void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType
         write_piece_moves(moves, from_square, move_list);
     }
 
-    uint64_t rooks = position.piece_bb(ROOK, position.turn) | position.piece_bb(QUEEN, position.turn);
+    uint64_t rooks = position.piece_bb(ROOK, Us) | position.piece_bb(QUEEN, Us);
     while (rooks) {
         int from_square = pop_lsb(rooks);
         uint64_t moves = get_rook_moves(from_square, all_pieces) & piece_targets;
@@ -235,16 +270,124 @@ void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType
         write_piece_moves(moves, from_square, move_list);
     }
 
-    uint64_t king_moves = get_king_moves(king_square) & targets;
+    uint64_t king_moves = get_king_moves(king_square) & targets & ~danger;
     if (move_type != GEN_TACTIC) {
-        king_moves |= get_castle_moves(position);
+        // the king can't castle through or into check
+        uint64_t castles = get_castle_moves<Us>(position);
+        while (castles) {
+            int to_square = pop_lsb(castles);
+            if (!(danger & (square_bb(to_square) | square_bb((king_square + to_square) / 2)))) {
+                king_moves |= square_bb(to_square);
+            }
+        }
     }
     write_piece_moves(king_moves, king_square, move_list);
 }
 
 
+// moves out of check: capture the checker, step the king away, or block a slider.
+// pinned pieces can't do any of these without exposing the king
+template<Color Us>
+static void generate_evasions(Position& position, MoveList* move_list) {
+    constexpr Color them = Us == WHITE ? BLACK : WHITE;
+    constexpr int dir = Us == WHITE ? -1 : 1;
+    constexpr uint64_t fourth_rank = Us == WHITE ? RANK_4 : RANK_5;
+    constexpr uint64_t promo_rank = Us == WHITE ? RANK_8 : RANK_1;
+
+    uint64_t friendly_pieces = position.piece_bb(ALL_PIECES, Us);
+    uint64_t all_pieces = position.occupancy();
+    uint64_t checkers = position.checkers();
+    int king_square = position.king_square(Us);
+
+    uint64_t movable = friendly_pieces & ~position.pinned() & ~square_bb(king_square);
+    uint64_t pawns = position.piece_bb(PAWN, Us) & movable;
+
+    auto add_pawn_move = [&](int from_square, int to_square) {
+        if (square_bb(to_square) & promo_rank) {
+            for (auto promo : {QUEEN, ROOK, BISHOP, KNIGHT}) {
+                move_list->add(Move(from_square, to_square, promo));
+            }
+        } else {
+            move_list->add(Move(from_square, to_square));
+        }
+    };
+
+    uint64_t king_moves = get_king_moves(king_square) & ~friendly_pieces & ~position.king_danger();
+    write_piece_moves(king_moves, king_square, move_list);
+
+    // double check: only king moves
+    if (popcount(checkers) > 1) {
+        return;
+    }
+    int checker_square = lsb(checkers);
+
+    // capture the checker
+    uint64_t capturers = position.get_attackers(checker_square, Us, all_pieces) & movable;
+    while (capturers) {
+        int from_square = pop_lsb(capturers);
+        if (pawns & square_bb(from_square)) {
+            add_pawn_move(from_square, checker_square);
+        } else {
+            move_list->add(Move(from_square, checker_square));
+        }
+    }
+
+    // a pawn that just gave check with a double push can also be taken en passant
+    int ep_col = position.ep_col();
+    if (ep_col >= 0 && checker_square == (3 + Us) * 8 + ep_col) {
+        int to_square = checker_square + dir * 8;
+        uint64_t ep_pawns = position.piece_bb(PAWN, Us) & get_pawn_attacks(to_square, them);
+        while (ep_pawns) {
+            int from_square = pop_lsb(ep_pawns);
+            if (is_legal_en_passant(position, from_square, to_square)) {
+                move_list->add(Move(from_square, to_square));
+            }
+        }
+    }
+
+    // block a slider on the squares between it and the king
+    uint64_t blocks = get_check_blocks(king_square, checker_square) & ~checkers;
+    while (blocks) {
+        int to_square = pop_lsb(blocks);
+
+        uint64_t blockers = position.get_attackers(to_square, Us, all_pieces) & movable & ~pawns;
+        while (blockers) {
+            move_list->add(Move(pop_lsb(blockers), to_square));
+        }
+
+        int from_square = to_square - dir * 8;
+        if (pawns & square_bb(from_square)) {
+            add_pawn_move(from_square, to_square);
+        } else if ((square_bb(to_square) & fourth_rank) && !position.piece_on(from_square) &&
+                   (pawns & square_bb(from_square - dir * 8))) {
+            move_list->add(Move(from_square - dir * 8, to_square));
+        }
+    }
+}
+
+// legal moves of the given type for the side to move
+void get_moves(Position& position, MoveList* move_list, MoveGenType move_type) {
+    if (position.checkers() && move_type == GEN_ALL) {
+        get_evasions(position, move_list);
+    } else if (position.turn == WHITE) {
+        generate_moves<WHITE>(position, move_list, move_type);
+    } else {
+        generate_moves<BLACK>(position, move_list, move_type);
+    }
+}
+
+void get_evasions(Position& position, MoveList* move_list) {
+    if (position.turn == WHITE) {
+        generate_evasions<WHITE>(position, move_list);
+    } else {
+        generate_evasions<BLACK>(position, move_list);
+    }
+}
+
+
 // move passed in should be pseudo legal
 bool is_legal(Position& position, Move move) {
+    PROFILE_SCOPE(LEGALITY);
     int king_square = position.king_square(position.turn);
 
     int from_square = move.from();
@@ -267,8 +410,7 @@ bool is_legal(Position& position, Move move) {
             }
             return true;
         } else {
-            return !position.get_attackers(
-              to_square, !position.turn, position.occupancy() & ~square_bb(king_square));
+            return !(position.king_danger() & square_bb(to_square));
         }
     }
 
@@ -283,15 +425,7 @@ bool is_legal(Position& position, Move move) {
 
     // en passant
     if (from_col != to_col && !position.piece_on(to_square)) {
-        int capture_square = from_row * 8 + to_col;
-        uint64_t occ = position.occupancy() ^ from_bb ^ to_bb ^ square_bb(capture_square);
-
-        if ((position.piece_bb(BISHOP, !position.turn) | position.piece_bb(QUEEN, !position.turn)) &
-             get_bishop_moves(king_square, occ)) {
-            return false;
-        }
-        return !((position.piece_bb(ROOK, !position.turn) | position.piece_bb(QUEEN, !position.turn)) &
-                  get_rook_moves(king_square, occ));
+        return is_legal_en_passant(position, from_square, to_square);
     }
 
     return !(position.pinned() & from_bb) ||
@@ -299,14 +433,7 @@ bool is_legal(Position& position, Move move) {
 }
 
 void get_legal_moves(Position& position, MoveList* move_list) {
-    MoveList pseudo_legals;
-    get_pseudo_legal_moves(position, &pseudo_legals);
-
-    for (Move move : pseudo_legals) {
-        if (is_legal(position, move)) {
-            move_list->add(move);
-        }
-    }
+    get_moves(position, move_list, GEN_ALL);
 }
 
 
@@ -396,6 +523,7 @@ uint64_t get_piece_moves(Position& position, int square) {
 
 
 bool is_pseudo_legal(Position& position, Move move) {
+    PROFILE_SCOPE(LEGALITY);
     // edge case: verify that the promotion flag is valid
     bool pawn_move = square_bb(move.from()) & position.piece_bb(PAWN, position.turn);
     bool pawn_valid = !pawn_move || !(square_bb(move.to()) & (RANK_1 | RANK_8)) || move.promote_to();
@@ -404,40 +532,210 @@ bool is_pseudo_legal(Position& position, Move move) {
 }
 
 
-bool no_legal_moves(Position& position) {
-    uint64_t pieces = position.piece_bb(ALL_PIECES, position.turn);
-    while (pieces) {
-        int from_square = pop_lsb(pieces);
+// counts pawn moves to the given squares, a promotion counts as four moves
+static inline int count_pawn_moves(uint64_t to_squares) {
+    uint64_t promotions = to_squares & (RANK_1 | RANK_8);
+    return popcount(to_squares & ~promotions) + 4 * popcount(promotions);
+}
 
-        uint64_t move_map = get_piece_moves(position, from_square);
-        while (move_map) {
-            int to_square = pop_lsb(move_map);
+// legal move count without writing moves: target bitboards are masked with the check and pin
+// masks and popcounted. only king steps, castling, en passant and pinned pawns are tested one by one.
+// with Any, returns as soon as a legal move is found
+template<bool Any, Color Us>
+static int count_legal(Position& position) {
+    constexpr Color them = Us == WHITE ? BLACK : WHITE;
+    uint64_t friendly_pieces = position.piece_bb(ALL_PIECES, Us);
+    uint64_t opp_pieces = position.piece_bb(ALL_PIECES, them);
+    uint64_t all_pieces = friendly_pieces | opp_pieces;
+    uint64_t pinned = position.pinned();
+    uint64_t checkers = position.checkers();
+    int king_square = position.king_square(Us);
+    int count = 0;
 
-            if (is_legal(position, Move(from_square, to_square))) {
-                return false;
-            }
+    uint64_t danger = position.king_danger();
+    count += popcount(get_king_moves(king_square) & ~friendly_pieces & ~danger);
+    if constexpr (Any) if (count) return count;
+
+    // double check: only king moves
+    if (popcount(checkers) > 1) {
+        return count;
+    }
+
+    uint64_t check_blocks = checkers ? get_check_blocks(king_square, lsb(checkers)) : ~0ULL;
+    uint64_t targets = ~friendly_pieces & check_blocks;
+
+    uint64_t knights = position.piece_bb(KNIGHT, Us) & ~pinned;
+    while (knights) {
+        count += popcount(get_knight_moves(pop_lsb(knights)) & targets);
+        if constexpr (Any) if (count) return count;
+    }
+
+    uint64_t bishops = position.piece_bb(BISHOP, Us) | position.piece_bb(QUEEN, Us);
+    while (bishops) {
+        int from_square = pop_lsb(bishops);
+        uint64_t moves = get_bishop_moves(from_square, all_pieces) & targets;
+        if (pinned & square_bb(from_square)) {
+            moves &= get_line_bb(from_square, king_square);
+        }
+        count += popcount(moves);
+        if constexpr (Any) if (count) return count;
+    }
+
+    uint64_t rooks = position.piece_bb(ROOK, Us) | position.piece_bb(QUEEN, Us);
+    while (rooks) {
+        int from_square = pop_lsb(rooks);
+        uint64_t moves = get_rook_moves(from_square, all_pieces) & targets;
+        if (pinned & square_bb(from_square)) {
+            moves &= get_line_bb(from_square, king_square);
+        }
+        count += popcount(moves);
+        if constexpr (Any) if (count) return count;
+    }
+
+    // unpinned pawns in bulk, as target squares
+    constexpr int up = Us == WHITE ? -8 : 8;
+    constexpr uint64_t third_rank = Us == WHITE ? RANK_3 : RANK_6;
+    uint64_t pawns = position.piece_bb(PAWN, Us);
+    uint64_t free_pawns = pawns & ~pinned;
+    uint64_t empty = ~all_pieces;
+    uint64_t single_pushes = shift<up>(free_pawns) & empty;
+    uint64_t double_pushes = shift<up>(single_pushes & third_rank) & empty;
+    uint64_t attacks = shift<up>(free_pawns);
+    uint64_t right_captures = ((attacks & 0x7f7f7f7f7f7f7f7f) << 1) & opp_pieces;
+    uint64_t left_captures = ((attacks & 0xfefefefefefefefe) >> 1) & opp_pieces;
+
+    count += count_pawn_moves(single_pushes & check_blocks);
+    count += popcount(double_pushes & check_blocks);
+    count += count_pawn_moves(right_captures & check_blocks);
+    count += count_pawn_moves(left_captures & check_blocks);
+    if constexpr (Any) if (count) return count;
+
+    // pinned pawns can only move along the pin
+    int ep_col = position.ep_col();
+    uint64_t ep_bb = ep_col >= 0 ? square_bb((Us == WHITE ? 2 : 5) * 8 + ep_col) : 0ULL;
+    uint64_t pinned_pawns = pawns & pinned;
+    while (pinned_pawns) {
+        int from_square = pop_lsb(pinned_pawns);
+        uint64_t moves = get_piece_moves(position, from_square) & ~ep_bb & get_line_bb(from_square, king_square);
+        count += count_pawn_moves(moves);
+        if constexpr (Any) if (count) return count;
+    }
+
+    // en passant can uncover a check along the rank, so it's tested
+    if (ep_bb) {
+        uint64_t ep_pawns = pawns & get_pawn_attacks(lsb(ep_bb), them);
+        while (ep_pawns) {
+            count += is_legal_en_passant(position, pop_lsb(ep_pawns), lsb(ep_bb));
+            if constexpr (Any) if (count) return count;
         }
     }
 
-    return true;
+    uint64_t castles = get_castle_moves<Us>(position);
+    while (castles) {
+        int to_square = pop_lsb(castles);
+        count += !(danger & (square_bb(to_square) | square_bb((king_square + to_square) / 2)));
+    }
+
+    return count;
+}
+
+int count_legal_moves(Position& position) {
+    return position.turn == WHITE ? count_legal<false, WHITE>(position) : count_legal<false, BLACK>(position);
+}
+
+bool no_legal_moves(Position& position) {
+    return position.turn == WHITE ? !count_legal<true, WHITE>(position) : !count_legal<true, BLACK>(position);
 }
 
 
 uint64_t bulk_perft(Position& position, int depth) {
     uint64_t nodes = 0;
-    
-    MoveList moves;
-    get_legal_moves(position, &moves);
 
     if (position.half_moves == depth - 1) {
-        return nodes + moves.size;
+        return count_legal_moves(position);
     }
 
+    MoveList moves;
+    get_legal_moves(position, &moves);
+
     for (Move move : moves) {
         position.make_move(move);
         nodes += bulk_perft(position, depth);
         position.pop();
     }
 
+    return nodes;
+}
+
+
+// leaf count with subtrees cached in the table, if one is given. depth is relative to the position
+uint64_t hashed_perft(Position& position, int depth, PerftTable* table) {
+    if (depth <= 0) {
+        return 1;
+    }
+
+    if (depth == 1) {
+        return count_legal_moves(position);
+    }
+
+    uint64_t key = position.pos_key();
+    uint64_t nodes;
+    if (table && table->get(key, depth, nodes)) {
+        return nodes;
+    }
+
+    MoveList moves;
+    get_legal_moves(position, &moves);
+
+    nodes = 0;
+    for (Move move : moves) {
+        position.make_move(move);
+        nodes += hashed_perft(position, depth - 1, table);
+        position.pop();
+    }
+
+    if (table) {
+        table->insert(key, depth, nodes);
+    }
+    return nodes;
+}
+
+// root moves are handed out to threads one at a time, and transposed subtrees
+// are shared between threads through the table. depth is relative to the position
+uint64_t parallel_perft(Position& position, int depth, int num_threads, int hash_mb) {
+    if (depth <= 0) {
+        return 1;
+    }
+
+    MoveList moves;
+    get_legal_moves(position, &moves);
+    if (depth == 1) {
+        return moves.size;
+    }
+
+    PerftTable table(hash_mb);
+    std::atomic<int> next_move = 0;
+    std::atomic<uint64_t> nodes = 0;
+
+    auto worker = [&]() {
+        Position local = position;
+        uint64_t local_nodes = 0;
+        for (int i = next_move++; i < moves.size; i = next_move++) {
+            local.make_move(moves.moves[i]);
+            local_nodes += hashed_perft(local, depth - 1, &table);
+            local.pop();
+        }
+        nodes += local_nodes;
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
     return nodes;
 }
\ No newline at end of file
@@ -5,8 +5,10 @@
 #include "position.hh"
 #include "move.hh"
 #include "nnue/simd.hh"
+#include "profiler.hh"
 
 class Position;
+class PerftTable;
 
 struct MoveList {
     Move moves[MAX_MOVES];
@@ -27,13 +29,19 @@ struct MoveList {
     }
 };
 
-void get_pseudo_legal_moves(Position& position, MoveList* move_list, MoveGenType move_type = GEN_ALL);
+void get_moves(Position& position, MoveList* move_list, MoveGenType move_type = GEN_ALL);
+// all legal moves when in check
+void get_evasions(Position& position, MoveList* move_list);
+// for moves not from the generator, like hash and killer moves. move should be pseudo legal
 bool is_legal(Position& position, Move move);
 void get_legal_moves(Position& position, MoveList* move_list);
 uint64_t get_piece_moves(Position& position, int square);
 bool is_pseudo_legal(Position& position, Move move);
 bool no_legal_moves(Position& position);
+int count_legal_moves(Position& position);
 
 uint64_t bulk_perft(Position& position, int depth);
+uint64_t hashed_perft(Position& position, int depth, PerftTable* table);
+uint64_t parallel_perft(Position& position, int depth, int num_threads, int hash_mb);
 
 #endif
\ No newline at end of file
@@ -6,12 +6,19 @@ MovePicker::MovePicker(Position& position, Engine& engine, int current_depth, Mo
     if (killer == hash_move) {
         killer = Move();
     }
+
+    if (position.checkers()) {
+        stage = STAGE_EVASION_HASH_MOVE;
+    }
 }
 
 template<MoveGenType Type>
 void MovePicker::get_scored_moves() {
     MoveList buffer;
-    get_pseudo_legal_moves(position, &buffer, Type);
+    {
+        PROFILE_SCOPE(MOVEGEN);
+        get_moves(position, &buffer, Type);
+    }
 
     scored_moves.size = 0;
 
@@ -38,6 +45,38 @@ void MovePicker::get_scored_moves() {
     }
 }
 
+void MovePicker::get_scored_evasions() {
+    MoveList buffer;
+    {
+        PROFILE_SCOPE(MOVEGEN);
+        get_evasions(position, &buffer);
+    }
+
+    scored_moves.size = 0;
+
+    int king_square = position.king_square(position.turn);
+    for (Move move : buffer) {
+        int score = 0;
+        int piece = position.piece_on(move.from());
+        int capture = position.piece_on(move.to());
+        int piece_type = Position::get_piece_type(piece);
+
+        if (capture) {
+            score += (1 << 29) + engine.capture_history[move.to()][piece_type][Position::get_piece_type(capture)];
+        } else if (move.from() == king_square) {
+            score += (1 << 28) + 2 * engine.quiet_history[move.from()][move.to()];
+        } else {
+            score += 2 * engine.quiet_history[move.from()][move.to()];
+
+            int ply = current_depth + MAX_CH_PLY;
+            score += engine.cont_history[ply - 1][move.to()][piece - 1];
+            score += engine.cont_history[ply - 2][move.to()][piece - 1];
+        }
+
+        scored_moves.add(ScoredMove(move, score));
+    }
+}
+
 static inline Move pop_best(ScoredMoveList& moves) {
     int best_idx = 0;
     for (int i = 1; i < moves.size; i++) {
@@ -53,6 +92,7 @@ static inline Move pop_best(ScoredMoveList& moves) {
 
 
 Move MovePicker::next_move() {
+    PROFILE_SCOPE(MOVEPICK);
     switch (stage) {
         case STAGE_HASH_MOVE: {
             stage++;
@@ -98,7 +138,7 @@ Move MovePicker::next_move() {
 
         case STAGE_KILLER: {
             stage++;
-            if (killer && is_pseudo_legal(position, killer)) {
+            if (killer && is_pseudo_legal(position, killer) && is_legal(position, killer)) {
                 return killer;
             }
 
@@ -140,6 +180,35 @@ Move MovePicker::next_move() {
             return Move();
         }
 
+        case STAGE_EVASION_HASH_MOVE: {
+            stage++;
+            if (hash_move) {
+                return hash_move;
+            }
+
+            [[fallthrough]];
+        }
+
+        case STAGE_GEN_EVASIONS: {
+            get_scored_evasions();
+            stage++;
+
+            [[fallthrough]];
+        }
+
+        case STAGE_EVASIONS: {
+            while (scored_moves.size) {
+                Move move = pop_best(scored_moves);
+
+                if (move == hash_move) {
+                    continue;
+                }
+                return move;
+            }
+
+            return Move();
+        }
+
         default:
             return Move();
     }
@@ -17,7 +17,12 @@ enum MoveStage : int {
     STAGE_KILLER,
     STAGE_GEN_QUIETS,
     STAGE_QUIETS,
-    STAGE_BAD_TACTICS
+    STAGE_BAD_TACTICS,
+
+    // in check, all moves come from the evasion generator
+    STAGE_EVASION_HASH_MOVE,
+    STAGE_GEN_EVASIONS,
+    STAGE_EVASIONS
 };
 
 struct ScoredMove {
@@ -50,7 +55,7 @@ struct ScoredMoveList {
     }
 };
 
-// generate tactics first, then quiet moves
+// generate tactics first, then quiet moves. in check, captures of the checker and king moves first
 class MovePicker {
     Position& position;
     Engine& engine;
@@ -66,6 +71,7 @@ public:
 
     MovePicker(Position& position, Engine& engine, int current_depth, Move hash_move = Move(), bool only_tactics = false);
     template<MoveGenType T> void get_scored_moves();
+    void get_scored_evasions();
     Move next_move();
 };
 
@@ -1,16 +1,28 @@
 #include "nnue.hh"
 
 namespace NNUE {
-    alignas(64) int16_t l1_weights[INPUT_SIZE][L1_SIZE];
-    alignas(64) int16_t l1_biases[L1_SIZE];
-    alignas(64) int8_t l2_weights[L1_SIZE / 4][L2_SIZE * 4];
-    alignas(64) float l2_biases[L2_SIZE];
-    alignas(64) float l3_weights[L2_SIZE][L3_SIZE];
-    alignas(64) float l3_biases[L3_SIZE];
-    alignas(64) float output_weights[L3_SIZE];
-                float output_bias;
+    struct Network {
+        alignas(64) int16_t l1_weights[INPUT_SIZE][L1_SIZE];
+        alignas(64) int16_t l1_biases[L1_SIZE];
+        alignas(64) int8_t l2_weights[L1_SIZE / 4][L2_SIZE * 4];
+        alignas(64) float l2_biases[L2_SIZE];
+        alignas(64) float l3_weights[L2_SIZE][L3_SIZE];
+        alignas(64) float l3_biases[L3_SIZE];
+        alignas(64) float output_weights[L3_SIZE];
+                    float output_bias;
+    };
 
-    alignas(64) uint8_t activated_accumulators[L1_SIZE];
+    Network network;
+
+    // read-only copies of the network, one per numa node
+    static std::vector<std::unique_ptr<Network>> replicas;
+    static std::mutex replicas_mutex;
+
+    // network read by this thread: the global one or its node's replica
+    thread_local const Network* thread_network = &network;
+
+    // scratch buffers for inference, one set per search thread
+    alignas(64) thread_local uint8_t activated_accumulators[L1_SIZE];
 
     static constexpr int jump32 = REGISTER_WIDTH / 32;
     static constexpr int jump16 = REGISTER_WIDTH / 16;
@@ -18,12 +30,12 @@ namespace NNUE {
     static constexpr int l2_chunks = L2_SIZE / jump32;
     static constexpr int l3_chunks = L3_SIZE / jump32;
 
-    alignas(64) vec_i32 l2_acc[l2_chunks];
-    alignas(64) float l2_buff[L2_SIZE];
-    alignas(64) vec_f32 l3_acc[l3_chunks];
+    alignas(64) thread_local vec_i32 l2_acc[l2_chunks];
+    alignas(64) thread_local float l2_buff[L2_SIZE];
+    alignas(64) thread_local vec_f32 l3_acc[l3_chunks];
 
-    alignas(64) uint16_t active_indices[L1_SIZE / 4];
-    int num_active = 0;
+    alignas(64) thread_local uint16_t active_indices[L1_SIZE / 4];
+    thread_local int num_active = 0;
 
     #if USE_NEON || USE_AVX2
         // indexed by every possible uint8 mask of active indices
@@ -71,32 +83,32 @@ namespace NNUE {
 
         in.read(reinterpret_cast<char *>(fl2_weights_stm), l2_read_size);
         in.read(reinterpret_cast<char *>(fl2_weights_opp), l2_read_size);
-        in.read(reinterpret_cast<char *>(l2_biases), sizeof(l2_biases));
+        in.read(reinterpret_cast<char *>(network.l2_biases), sizeof(network.l2_biases));
 
-        in.read(reinterpret_cast<char *>(l3_weights), sizeof(l3_weights));
-        in.read(reinterpret_cast<char *>(l3_biases), sizeof(l3_biases));
+        in.read(reinterpret_cast<char *>(network.l3_weights), sizeof(network.l3_weights));
+        in.read(reinterpret_cast<char *>(network.l3_biases), sizeof(network.l3_biases));
 
-        in.read(reinterpret_cast<char *>(output_weights), sizeof(output_weights));
-        in.read(reinterpret_cast<char *>(&output_bias), sizeof(output_bias));
+        in.read(reinterpret_cast<char *>(network.output_weights), sizeof(network.output_weights));
+        in.read(reinterpret_cast<char *>(&network.output_bias), sizeof(network.output_bias));
 
         in.close();
 
         for (int i = 0; i < INPUT_SIZE; i++) {
             for (int j = 0; j < L1_SIZE; j++) {
-                l1_weights[i][j] = static_cast<int16_t>(std::round(fl1_weights[i * L1_SIZE + j] * QA));
+                network.l1_weights[i][j] = static_cast<int16_t>(std::round(fl1_weights[i * L1_SIZE + j] * QA));
             }
         }
         for (int i = 0; i < L1_SIZE; i++) {
-            l1_biases[i] = static_cast<int16_t>(std::round(fl1_biases[i] * QA));
+            network.l1_biases[i] = static_cast<int16_t>(std::round(fl1_biases[i] * QA));
         }
 
         // l2_weights are grouped by four and side-to-move and opponent weights are concatenated
         for (int i = 0; i < L1_SIZE / 8; i++) {
             for (int j = 0; j < L2_SIZE; j++) {
                 for (int k = 0; k < 4; k++) {
-                    l2_weights[i][j * 4 + k] =
+                    network.l2_weights[i][j * 4 + k] =
                       static_cast<int8_t>(std::round(fl2_weights_stm[(i * 4 + k) * L2_SIZE + j] * QB));
-                    l2_weights[i + L1_SIZE / 8][j * 4 + k] =
+                    network.l2_weights[i + L1_SIZE / 8][j * 4 + k] =
                       static_cast<int8_t>(std::round(fl2_weights_opp[(i * 4 + k) * L2_SIZE + j] * QB));
                 }
             }
@@ -119,12 +131,34 @@ namespace NNUE {
                 }
             }
         #endif
+
+        // keep existing replicas in sync with the loaded weights
+        std::lock_guard<std::mutex> lock(replicas_mutex);
+        for (auto& replica : replicas) {
+            if (replica) {
+                *replica = network;
+            }
+        }
+    }
+
+    // the replica is copied by the first thread bound to the node, so first-touch
+    // places its pages in that node's memory
+    void use_numa_replica(int node) {
+        std::lock_guard<std::mutex> lock(replicas_mutex);
+        if (int(replicas.size()) <= node) {
+            replicas.resize(node + 1);
+        }
+        if (!replicas[node]) {
+            replicas[node] = std::make_unique<Network>(network);
+        }
+        thread_network = replicas[node].get();
     }
 
 
     void reset_accumulators(Position& position, Accumulator& accumulator) {
-        std::memcpy(accumulator.acc[WHITE], l1_biases, L1_SIZE * sizeof(int16_t));
-        std::memcpy(accumulator.acc[BLACK], l1_biases, L1_SIZE * sizeof(int16_t));
+        const Network& net = *thread_network;
+        std::memcpy(accumulator.acc[WHITE], net.l1_biases, L1_SIZE * sizeof(int16_t));
+        std::memcpy(accumulator.acc[BLACK], net.l1_biases, L1_SIZE * sizeof(int16_t));
 
         int white_king = position.king_square(WHITE);
         int black_king = position.king_square(BLACK);
@@ -140,8 +174,8 @@ namespace NNUE {
             int black_idx = make_index<BLACK>(square, piece, black_mirror);
 
             for (int i = 0; i < L1_SIZE; i++) {
-                accumulator.acc[WHITE][i] += l1_weights[white_idx][i];
-                accumulator.acc[BLACK][i] += l1_weights[black_idx][i];
+                accumulator.acc[WHITE][i] += net.l1_weights[white_idx][i];
+                accumulator.acc[BLACK][i] += net.l1_weights[black_idx][i];
             }
         }
 
@@ -154,6 +188,7 @@ namespace NNUE {
 
     // not optimized - used for debugging
     int evaluate(Position& position) {
+        const Network& net = *thread_network;
         Accumulator accumulator;
         reset_accumulators(position, accumulator);
 
@@ -173,19 +208,19 @@ namespace NNUE {
                 int pw_opp = (opp0 * opp1) / 512;
 
                 for (int j = 0; j < L2_SIZE; j++) {
-                    l2_layer[j] += pw_stm * l2_weights[i][j * 4 + k];
-                    l2_layer[j] += pw_opp * l2_weights[i + L1_SIZE / 8][j * 4 + k];
+                    l2_layer[j] += pw_stm * net.l2_weights[i][j * 4 + k];
+                    l2_layer[j] += pw_opp * net.l2_weights[i + L1_SIZE / 8][j * 4 + k];
                 }
             }
         }
 
         float l3_layer[L3_SIZE];
-        std::memcpy(l3_layer, l3_biases, L3_SIZE * sizeof(float));
+        std::memcpy(l3_layer, net.l3_biases, L3_SIZE * sizeof(float));
         for (int i = 0; i < L2_SIZE; i++) {
-            float l2 = l2_biases[i] + float(l2_layer[i] * 512) / float(QA * QA * QB);
+            float l2 = net.l2_biases[i] + float(l2_layer[i] * 512) / float(QA * QA * QB);
             l2 = crelu(l2, 1.0);
             for (int j = 0; j < L3_SIZE; j++) {
-                l3_layer[j] += l2 * l3_weights[i][j];
+                l3_layer[j] += l2 * net.l3_weights[i][j];
             }
         }
 
@@ -193,9 +228,9 @@ namespace NNUE {
             l3_layer[i] = crelu(l3_layer[i], 1.0);
         }
 
-        float output = output_bias;
+        float output = net.output_bias;
         for (int i = 0; i < L3_SIZE; i++) {
-            output += l3_layer[i] * output_weights[i];
+            output += l3_layer[i] * net.output_weights[i];
         }
 
         return output * float(SCALE);
@@ -204,6 +239,7 @@ namespace NNUE {
 
     // efficiently update accumulator - only have to worry about the few indices that changed this move
     void update_accumulators(Accumulator* accumulator) {
+        const Network& net = *thread_network;
         accumulator->clean = true;
         DirtyPieces dps = accumulator->dps;
 
@@ -212,10 +248,10 @@ namespace NNUE {
         const int16_t* __restrict prev_white = (accumulator - 1)->acc[WHITE];
         const int16_t* __restrict prev_black = (accumulator - 1)->acc[BLACK];
 
-        const int16_t* __restrict white_add0 = l1_weights[dps.white_add0];
-        const int16_t* __restrict black_add0 = l1_weights[dps.black_add0];
-        const int16_t* __restrict white_sub0 = l1_weights[dps.white_sub0];
-        const int16_t* __restrict black_sub0 = l1_weights[dps.black_sub0];
+        const int16_t* __restrict white_add0 = net.l1_weights[dps.white_add0];
+        const int16_t* __restrict black_add0 = net.l1_weights[dps.black_add0];
+        const int16_t* __restrict white_sub0 = net.l1_weights[dps.white_sub0];
+        const int16_t* __restrict black_sub0 = net.l1_weights[dps.black_sub0];
 
         // compilers should vectorize this automatically
         if (dps.type == DIRTY_QUIET || dps.type == DIRTY_PROMOTION) {
@@ -226,18 +262,18 @@ namespace NNUE {
             }
         } else if (dps.type == DIRTY_CAPTURE || dps.type == DIRTY_CAP_PROMO || dps.type == DIRTY_EP) {
             // add sub sub
-            const int16_t* __restrict white_sub1 = l1_weights[dps.white_sub1];
-            const int16_t* __restrict black_sub1 = l1_weights[dps.black_sub1];
+            const int16_t* __restrict white_sub1 = net.l1_weights[dps.white_sub1];
+            const int16_t* __restrict black_sub1 = net.l1_weights[dps.black_sub1];
             for (int i = 0; i < L1_SIZE; i++) {
                 acc_white[i] = prev_white[i] + white_add0[i] - white_sub0[i] - white_sub1[i];
                 acc_black[i] = prev_black[i] + black_add0[i] - black_sub0[i] - black_sub1[i];
             }
         } else {
             // castle: add add sub sub
-            const int16_t* __restrict white_add1 = l1_weights[dps.white_add1];
-            const int16_t* __restrict black_add1 = l1_weights[dps.black_add1];
-            const int16_t* __restrict white_sub1 = l1_weights[dps.white_sub1];
-            const int16_t* __restrict black_sub1 = l1_weights[dps.black_sub1];
+            const int16_t* __restrict white_add1 = net.l1_weights[dps.white_add1];
+            const int16_t* __restrict black_add1 = net.l1_weights[dps.black_add1];
+            const int16_t* __restrict white_sub1 = net.l1_weights[dps.white_sub1];
+            const int16_t* __restrict black_sub1 = net.l1_weights[dps.black_sub1];
             for (int i = 0; i < L1_SIZE; i++) {
                 acc_white[i] = prev_white[i] + white_add0[i] + white_add1[i] - white_sub0[i] - white_sub1[i];
                 acc_black[i] = prev_black[i] + black_add0[i] + black_add1[i] - black_sub0[i] - black_sub1[i];
@@ -391,6 +427,7 @@ namespace NNUE {
 
 
     int evaluate_incremental(Accumulator& accumulator, int turn) {
+        const Network& net = *thread_network;
         activate_accumulators(accumulator, turn);
 
         for (int i = 0; i < l2_chunks; i++) {
@@ -409,7 +446,7 @@ namespace NNUE {
             int idx = active_indices[i];
             vec_u8 vals = vec_dup_u32(grouped_activations[idx]);
             for (int j = 0; j < l2_chunks; j++) {
-                vec_i8 weights = vec_load_i8(l2_weights[idx] + j * jump8);
+                vec_i8 weights = vec_load_i8(net.l2_weights[idx] + j * jump8);
                 l2_acc[j] = vec_dpbusd_i32(l2_acc[j], vals, weights);
             }
         }
@@ -420,7 +457,7 @@ namespace NNUE {
             // convert to floats and normalize
             vec_f32 v = vec_i32_to_f32(l2_acc[i]);
             v = vec_mul_f32(v, v_L2_norm);
-            v = vec_add_f32(v, vec_load_f32(l2_biases + jump32 * i));
+            v = vec_add_f32(v, vec_load_f32(net.l2_biases + jump32 * i));
 
             // crelu
             v = vec_max_f32(v, v_zero_f32);
@@ -430,13 +467,13 @@ namespace NNUE {
         }
 
         for (int i = 0; i < l3_chunks; i++) {
-            l3_acc[i] = vec_load_f32(l3_biases + jump32 * i);
+            l3_acc[i] = vec_load_f32(net.l3_biases + jump32 * i);
         }
 
         for (int i = 0; i < L2_SIZE; i++) {
             vec_f32 l2 = vec_dup_f32(l2_buff[i]);
             for (int j = 0; j < l3_chunks; j++) {
-                l3_acc[j] = vec_mla_f32(l3_acc[j], l2, vec_load_f32(l3_weights[i] + jump32 * j));
+                l3_acc[j] = vec_mla_f32(l3_acc[j], l2, vec_load_f32(net.l3_weights[i] + jump32 * j));
             }
         }
 
@@ -444,11 +481,11 @@ namespace NNUE {
         for (int i = 0; i < l3_chunks; i++) {
             vec_f32 l3 = vec_max_f32(l3_acc[i], v_zero_f32);
             l3 = vec_min_f32(l3, v_one_f32);
-            vec_f32 w = vec_load_f32(output_weights + jump32 * i);
+            vec_f32 w = vec_load_f32(net.output_weights + jump32 * i);
             acc = vec_mla_f32(acc, l3, w);
         }
 
-        float output = output_bias + vec_sum_f32(acc);
+        float output = net.output_bias + vec_sum_f32(acc);
         return output * float(SCALE);
     }
 }
\ No newline at end of file
@@ -8,6 +8,9 @@
 #include <cstring>
 #include <cstdint>
 #include <filesystem>
+#include <vector>
+#include <memory>
+#include <mutex>
 
 #if defined(__APPLE__)
 #include <mach-o/dyld.h>
@@ -36,6 +39,9 @@ namespace NNUE {
 
     void init();
 
+    // read network weights from a copy local to the given numa node
+    void use_numa_replica(int node);
+
     // chess is horizontally invariant, so the network is trained with each
     // perspective's king always on the left to reduce the state space
     static inline bool is_mirrored(int king_square) {
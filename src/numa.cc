@@ -0,0 +1,121 @@
+#include "numa.hh"
+
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Numa {
+    Policy policy = NUMA_AUTO;
+
+    // parse sysfs list format, ex: "0-3,8-11"
+    static std::vector<int> parse_list(std::string list) {
+        std::vector<int> values;
+        std::istringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty() || !isdigit(range[0])) {
+                continue;
+            }
+
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int i = first; i <= last; i++) {
+                values.push_back(i);
+            }
+        }
+        return values;
+    }
+
+    static std::vector<std::vector<int>> read_topology() {
+        std::vector<std::vector<int>> nodes;
+
+    #if defined(__linux__)
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string line;
+        if (online && std::getline(online, line)) {
+            for (int node : parse_list(line)) {
+                std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string cpus;
+                if (cpulist && std::getline(cpulist, cpus)) {
+                    std::vector<int> node_cpus = parse_list(cpus);
+                    // memory-only nodes can't run threads
+                    if (!node_cpus.empty()) {
+                        nodes.push_back(node_cpus);
+                    }
+                }
+            }
+        }
+    #endif
+
+        if (nodes.empty()) {
+            nodes.push_back({});
+        }
+        return nodes;
+    }
+
+    const std::vector<std::vector<int>>& topology() {
+        static const std::vector<std::vector<int>> nodes = read_topology();
+        return nodes;
+    }
+
+    int num_nodes() {
+        return topology().size();
+    }
+
+    int node_for_thread(int thread_id) {
+        if (policy == NUMA_NONE || num_nodes() < 2) {
+            return -1;
+        }
+
+        // spread threads evenly so every node's memory bandwidth is used
+        return thread_id % num_nodes();
+    }
+
+    void bind_thread(int node) {
+    #if defined(__linux__)
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (int cpu : topology()[node]) {
+            CPU_SET(cpu, &mask);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mask);
+    #endif
+    }
+
+    void interleave(void* memory, size_t bytes) {
+    #if defined(__linux__) && defined(SYS_mbind)
+        if (policy == NUMA_NONE || num_nodes() < 2) {
+            return;
+        }
+
+        constexpr int MPOL_INTERLEAVE = 3;
+        constexpr int MAX_NODES = 1024;
+        unsigned long node_mask[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string line;
+        if (!online || !std::getline(online, line)) {
+            return;
+        }
+        for (int node : parse_list(line)) {
+            if (node < MAX_NODES) {
+                node_mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+            }
+        }
+
+        // best effort: pages fall back to first touch if this fails
+        syscall(SYS_mbind, memory, bytes, MPOL_INTERLEAVE, node_mask, MAX_NODES, 0);
+    #endif
+    }
+
+    Policy policy_from_string(std::string name) {
+        return name == "none" ? NUMA_NONE : NUMA_AUTO;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef numa_hh
+#define numa_hh
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// numa-aware placement for multi-socket machines.
+// topology is read from /sys on linux; elsewhere the machine is treated as one node
+namespace Numa {
+    enum Policy {
+        NUMA_AUTO, // bind threads, replicate network weights and interleave the tt when there are several nodes
+        NUMA_NONE  // leave placement to the os
+    };
+
+    extern Policy policy;
+
+    // cpus on each node
+    const std::vector<std::vector<int>>& topology();
+
+    int num_nodes();
+
+    // node a search thread should run on, or -1 if threads are not bound
+    int node_for_thread(int thread_id);
+
+    void bind_thread(int node);
+
+    // spread pages of a page aligned allocation over all nodes
+    void interleave(void* memory, size_t bytes);
+
+    Policy policy_from_string(std::string name);
+};
+
+#endif
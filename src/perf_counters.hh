@@ -0,0 +1,134 @@
+#ifndef perf_counters_hh
+#define perf_counters_hh
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// hardware performance counters around a bench run, through perf_event_open.
+// counters that can't be opened (no pmu in a vm, perf_event_paranoid, other platforms) are skipped
+class PerfCounters {
+    struct Counter {
+        std::string name;
+        int fd;
+        uint64_t value;
+    };
+
+    std::vector<Counter> counters;
+    std::vector<std::string> unavailable;
+
+    static constexpr uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+        return cache | (op << 8) | (result << 16);
+    }
+
+    void open(std::string name, uint32_t type, uint64_t config) {
+    #if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1; // count threads started after enabling, for multithreaded bench
+        // software events like context switches only happen in the kernel
+        attr.exclude_kernel = type != PERF_TYPE_SOFTWARE;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd >= 0) {
+            counters.push_back({name, fd, 0});
+            return;
+        }
+    #endif
+        unavailable.push_back(name);
+    }
+
+public:
+    PerfCounters() {
+    #if defined(__linux__)
+        open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open("branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        open("l1d misses", PERF_TYPE_HW_CACHE,
+            cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+        open("llc misses", PERF_TYPE_HW_CACHE,
+            cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+        open("dtlb misses", PERF_TYPE_HW_CACHE,
+            cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+        open("page faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+        open("context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+    #endif
+    }
+
+    ~PerfCounters() {
+        for (Counter& counter : counters) {
+            close(counter.fd);
+        }
+    }
+
+    void start() {
+    #if defined(__linux__)
+        for (Counter& counter : counters) {
+            ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    #endif
+    }
+
+    void stop() {
+    #if defined(__linux__)
+        for (Counter& counter : counters) {
+            ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+
+            // value, time enabled, time running. scale up if the counter was multiplexed
+            uint64_t data[3] = {};
+            if (read(counter.fd, data, sizeof(data)) != sizeof(data) || !data[2]) {
+                counter.value = 0;
+            } else {
+                counter.value = uint64_t((double) data[0] * data[1] / data[2]);
+            }
+        }
+    #endif
+    }
+
+    uint64_t get(std::string name) {
+        for (Counter& counter : counters) {
+            if (counter.name == name) {
+                return counter.value;
+            }
+        }
+        return 0;
+    }
+
+    void print(uint64_t nodes) {
+        for (Counter& counter : counters) {
+            printf("%-17s %15llu  %10.2f / node\n", (counter.name + ":").c_str(), counter.value,
+                nodes ? (double) counter.value / nodes : 0.0);
+        }
+
+        uint64_t cycles = get("cycles");
+        if (cycles) {
+            printf("ipc: %.2f\n", (double) get("instructions") / cycles);
+        }
+
+        if (!unavailable.empty()) {
+            std::string names;
+            for (std::string& name : unavailable) {
+                names += (names.empty() ? "" : ", ") + name;
+            }
+            printf("unavailable counters: %s\n", names.c_str());
+        }
+    }
+};
+
+#endif
@@ -1,11 +1,19 @@
 #include <chrono>
 #include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <memory>
 
 #include "move.hh"
 #include "position.hh"
 #include "engine.hh"
 #include "movegen.hh"
 #include "movepick.hh"
+#include "perft_table.hh"
+#include "init.hh"
 
 
 Engine engine;
@@ -56,22 +64,173 @@ void perft(Position& position, int max_depth) {
     }
 }
 
+// perft suite in epd format: <fen> ;D1 <count> ;D2 <count> ...
+struct SuiteEntry {
+    std::string fen;
+    std::vector<std::pair<int, uint64_t>> expected; // depth, leaf count
+};
+
+struct SuiteResult {
+    uint64_t nodes = 0;
+    int failed_depth = 0;
+    uint64_t expected = 0;
+    uint64_t found = 0;
+};
+
+static std::vector<SuiteEntry> read_suite(std::string path) {
+    std::vector<SuiteEntry> suite;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string field;
+        std::getline(fields, field, ';');
+        if (field.find_first_not_of(" \t\r") == std::string::npos || field[0] == '#') {
+            continue;
+        }
+
+        SuiteEntry entry;
+        entry.fen = field.substr(0, field.find_last_not_of(" \t\r") + 1);
+        while (std::getline(fields, field, ';')) {
+            std::istringstream ss(field);
+            std::string depth;
+            uint64_t count;
+            if (ss >> depth >> count && depth.size() > 1 && depth[0] == 'D') {
+                entry.expected.push_back({std::stoi(depth.substr(1)), count});
+            }
+        }
+        suite.push_back(entry);
+    }
+    return suite;
+}
+
+// leaf count under each root move, to compare against another engine's divide
+static void divide(Position& position, int depth, PerftTable* table) {
+    MoveList moves;
+    get_legal_moves(position, &moves);
+    for (Move move : moves) {
+        position.make_move(move);
+        printf("    %s: %llu\n", move.to_uci().c_str(), hashed_perft(position, depth - 1, table));
+        position.pop();
+    }
+}
+
+// positions are handed out to threads one at a time. each position is checked depth by depth
+// and stops at the first mismatch
+static int run_suite(std::string path, int max_depth, int num_threads, int hash_mb) {
+    std::vector<SuiteEntry> suite = read_suite(path);
+    if (suite.empty()) {
+        printf("Error: no positions in %s\n", path.c_str());
+        return 1;
+    }
+
+    std::unique_ptr<PerftTable> table;
+    if (hash_mb) {
+        table = std::make_unique<PerftTable>(hash_mb);
+    }
+
+    std::vector<SuiteResult> results(suite.size());
+    std::atomic<size_t> next_entry = 0;
+
+    auto worker = [&]() {
+        Position position;
+        for (size_t i = next_entry++; i < suite.size(); i = next_entry++) {
+            position.set_fen(suite[i].fen);
+            for (auto& [depth, expected] : suite[i].expected) {
+                if (max_depth && depth > max_depth) {
+                    continue;
+                }
+
+                uint64_t found = hashed_perft(position, depth, table.get());
+                results[i].nodes += found;
+                if (found != expected) {
+                    results[i].failed_depth = depth;
+                    results[i].expected = expected;
+                    results[i].found = found;
+                    break;
+                }
+            }
+        }
+    };
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    int time_taken = std::max(1, (int) std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count());
+
+    uint64_t nodes = 0;
+    int failed = 0;
+    for (size_t i = 0; i < suite.size(); i++) {
+        nodes += results[i].nodes;
+        if (!results[i].failed_depth) {
+            continue;
+        }
+
+        failed++;
+        printf("FAIL %s\n", suite[i].fen.c_str());
+        printf("  depth %d: expected %llu, found %llu\n", results[i].failed_depth, results[i].expected, results[i].found);
+
+        Position position(suite[i].fen);
+        divide(position, results[i].failed_depth, table.get());
+    }
+
+    printf("positions: %zu, passed: %zu, failed: %d\n", suite.size(), suite.size() - failed, failed);
+    printf("time: %f\n", (float) time_taken / 1000);
+    printf("nodes: %llu\n", nodes);
+    printf("nps: %f M\n", (double) nodes / (time_taken * 1000));
+    return failed ? 1 : 0;
+}
+
 int main(int argc, char* argv[]) {
+    init_all();
     Position position;
 
+    // perft [depth] [-b] [-t threads] [-hash mb]
+    // -b counts leaves only. -t or -hash also counts leaves, with threads and a perft hash table
+    // perft -suite <file.epd> [-depth max] [-t threads] [-hash mb]
     int depth = 6;
     bool bulk = false;
+    int num_threads = 0;
+    int hash_mb = 0;
+    std::string suite_file;
+    int max_depth = 0;
     for (int i = 1; i < argc; i++) {
-        if (std::string(argv[i]) == "-b") {
+        std::string arg = argv[i];
+        if (arg == "-b") {
             bulk = true;
+        } else if (arg == "-suite" && i + 1 < argc) {
+            suite_file = argv[++i];
+        } else if (arg == "-depth" && i + 1 < argc) {
+            max_depth = std::stoi(argv[++i]);
+        } else if (arg == "-t" && i + 1 < argc) {
+            num_threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "-hash" && i + 1 < argc) {
+            hash_mb = std::max(0, std::stoi(argv[++i]));
         } else {
-            depth = std::stoi(argv[i]);
+            depth = std::stoi(arg);
         }
     }
 
+    if (!suite_file.empty()) {
+        // hash 0 disables the table so nps measures move generation alone
+        bool hash_given = false;
+        for (int i = 1; i < argc; i++) hash_given |= std::string(argv[i]) == "-hash";
+        return run_suite(suite_file, max_depth, num_threads ? num_threads : std::max(1u, std::thread::hardware_concurrency()),
+            hash_given ? hash_mb : 64);
+    }
+
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    if (bulk) {
+    if (num_threads || hash_mb) {
+        leafs = parallel_perft(position, depth, std::max(1, num_threads), hash_mb ? hash_mb : 64);
+    } else if (bulk) {
         leafs = bulk_perft(position, depth);
     } else {
         perft(position, depth);
@@ -0,0 +1,62 @@
+#ifndef perft_table_hh
+#define perft_table_hh
+
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <memory>
+
+// (hash, depth) -> leaf count cache shared by perft threads without locks.
+// the key is stored xored with the data, so an entry torn by a concurrent write fails
+// the key check instead of returning a wrong count
+class PerftTable {
+    struct Entry {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data; // count << 8 | depth
+    };
+
+    std::unique_ptr<Entry[]> table;
+    size_t size = 0;
+
+    // different depths of the same position go to different slots
+    Entry& entry(uint64_t key, int depth) {
+        return table[(key ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL)) & (size - 1)];
+    }
+
+public:
+    PerftTable(size_t megabytes) {
+        // round down to a power of two so the index is a mask
+        size_t entries = megabytes * 1024 * 1024 / sizeof(Entry);
+        size = 1;
+        while (size * 2 <= entries) {
+            size *= 2;
+        }
+
+        table = std::make_unique<Entry[]>(size);
+        for (size_t i = 0; i < size; i++) {
+            table[i].check.store(0, std::memory_order_relaxed);
+            table[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool get(uint64_t key, int depth, uint64_t& count) {
+        Entry& e = entry(key, depth);
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        uint64_t check = e.check.load(std::memory_order_relaxed);
+        if ((check ^ data) != key || (data & 0xFF) != uint64_t(depth)) {
+            return false;
+        }
+
+        count = data >> 8;
+        return true;
+    }
+
+    void insert(uint64_t key, int depth, uint64_t count) {
+        Entry& e = entry(key, depth);
+        uint64_t data = count << 8 | uint64_t(depth);
+        e.check.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "polyglot.hh"
 
+#include <random>
+
 namespace Polyglot {
     struct polyglot_entry {
         uint64_t key;
@@ -124,16 +124,26 @@ void Position::set_fen(std::string fen) {
 
     set_keys();
     state->checkers = get_attackers(king_square(turn), !turn, occupancy());
-    state->pinned[WHITE] = get_pinned(WHITE);
-    state->pinned[BLACK] = get_pinned(BLACK);
+    state->cached[WHITE] = 0;
+    state->cached[BLACK] = 0;
 }
 
 Position::Position(std::string fen) {
-    Zobrist::init();
-    init_bitboards();    
     set_fen(fen);
 }
 
+Position::Position(const Position& other) {
+    *this = other;
+}
+
+Position& Position::operator=(const Position& other) {
+    stack = other.stack;
+    half_moves = other.half_moves;
+    turn = other.turn;
+    state = &stack[half_moves];
+    return *this;
+}
+
 
 uint64_t Position::get_attackers(int square, int color, uint64_t blockers) {
     uint64_t attackers = piece_bb(PAWN, color) & get_pawn_attacks(square, !color);
@@ -146,29 +156,167 @@ uint64_t Position::get_attackers(int square, int color, uint64_t blockers) {
 }
 
 bool Position::is_attacked(int square) {
-    return bool(get_attackers(square, !turn, occupancy()));
+    return attacks(ALL_PIECES, !turn) & square_bb(square);
 }
 
-uint64_t Position::get_pinned(int color) {
-    int king_sq = king_square(color);
-    uint64_t pinned = 0ULL;
-    uint64_t pinners = (get_rook_moves(king_sq, 0ULL) & (piece_bb(ROOK, !color) | piece_bb(QUEEN, !color))) |
-                       (get_bishop_moves(king_sq, 0ULL) & (piece_bb(BISHOP, !color) | piece_bb(QUEEN, !color)));
-
-    uint64_t occ = occupancy() & ~pinners;
-    while (pinners) {
-        int square = pop_lsb(pinners);
-        uint64_t between = get_check_blocks(king_sq, square) & occ;
-        if (popcount(between) == 1 && (between & piece_bb(ALL_PIECES, color))) {
-            pinned |= between;
+// pieces of either color that are the only piece between a slider and the king
+uint64_t Position::get_blockers(int king_color, int slider_color) {
+    int king_sq = king_square(king_color);
+    uint64_t blockers = 0ULL;
+    uint64_t sliders = (get_rook_moves(king_sq, 0ULL) & (piece_bb(ROOK, slider_color) | piece_bb(QUEEN, slider_color))) |
+                       (get_bishop_moves(king_sq, 0ULL) & (piece_bb(BISHOP, slider_color) | piece_bb(QUEEN, slider_color)));
+
+    // only the slider itself is taken off, so a second piece in front of it means no blocker
+    uint64_t occ = occupancy();
+    while (sliders) {
+        int square = pop_lsb(sliders);
+        uint64_t between = get_check_blocks(king_sq, square) & ~square_bb(square) & occ;
+        if (popcount(between) == 1) {
+            blockers |= between;
         }
     }
 
-    return pinned;
+    return blockers;
+}
+
+uint64_t Position::get_pinned(int color) {
+    return get_blockers(color, !color) & piece_bb(ALL_PIECES, color);
+}
+
+// squares attacked by the opponent. sliders see through the king, so it
+// can't step away from a slider along its own ray
+uint64_t Position::get_king_danger(int color) {
+    int them = !color;
+    uint64_t occ = occupancy() & ~piece_bb(KING, color);
+
+    uint64_t pawns = piece_bb(PAWN, them);
+    uint64_t forward = them == WHITE ? pawns >> 8 : pawns << 8;
+    uint64_t danger = ((forward & 0x7f7f7f7f7f7f7f7f) << 1) | ((forward & 0xfefefefefefefefe) >> 1);
+
+    danger |= get_king_moves(king_square(them));
+
+    uint64_t knights = piece_bb(KNIGHT, them);
+    while (knights) {
+        danger |= get_knight_moves(pop_lsb(knights));
+    }
+
+    uint64_t bishops = piece_bb(BISHOP, them) | piece_bb(QUEEN, them);
+    while (bishops) {
+        danger |= get_bishop_moves(pop_lsb(bishops), occ);
+    }
+
+    uint64_t rooks = piece_bb(ROOK, them) | piece_bb(QUEEN, them);
+    while (rooks) {
+        danger |= get_rook_moves(pop_lsb(rooks), occ);
+    }
+
+    return danger;
+}
+
+void Position::set_attacks(int color) {
+    uint64_t occ = occupancy();
+    uint64_t (&attacks)[7][2] = state->attacks;
+
+    uint64_t pawns = piece_bb(PAWN, color);
+    uint64_t forward = color == WHITE ? pawns >> 8 : pawns << 8;
+    attacks[PAWN][color] = ((forward & 0x7f7f7f7f7f7f7f7f) << 1) | ((forward & 0xfefefefefefefefe) >> 1);
+
+    attacks[KNIGHT][color] = 0ULL;
+    uint64_t knights = piece_bb(KNIGHT, color);
+    while (knights) {
+        attacks[KNIGHT][color] |= get_knight_moves(pop_lsb(knights));
+    }
+
+    attacks[BISHOP][color] = 0ULL;
+    uint64_t bishops = piece_bb(BISHOP, color);
+    while (bishops) {
+        attacks[BISHOP][color] |= get_bishop_moves(pop_lsb(bishops), occ);
+    }
+
+    attacks[ROOK][color] = 0ULL;
+    uint64_t rooks = piece_bb(ROOK, color);
+    while (rooks) {
+        attacks[ROOK][color] |= get_rook_moves(pop_lsb(rooks), occ);
+    }
+
+    attacks[QUEEN][color] = 0ULL;
+    uint64_t queens = piece_bb(QUEEN, color);
+    while (queens) {
+        attacks[QUEEN][color] |= get_queen_moves(pop_lsb(queens), occ);
+    }
+
+    attacks[KING][color] = get_king_moves(king_square(color));
+
+    attacks[ALL_PIECES][color] = attacks[PAWN][color] | attacks[KNIGHT][color] | attacks[BISHOP][color] |
+                                 attacks[ROOK][color] | attacks[QUEEN][color] | attacks[KING][color];
+    state->cached[color] |= CACHED_ATTACKS;
+}
+
+// squares each piece type of color would give check from, and its pieces that give
+// a discovered check by leaving the line to the other king
+void Position::set_check_info(int color) {
+    int king_sq = king_square(!color);
+    uint64_t occ = occupancy();
+    uint64_t (&check_squares)[6][2] = state->check_squares;
+
+    check_squares[PAWN][color] = get_pawn_attacks(king_sq, !color);
+    check_squares[KNIGHT][color] = get_knight_moves(king_sq);
+    check_squares[BISHOP][color] = get_bishop_moves(king_sq, occ);
+    check_squares[ROOK][color] = get_rook_moves(king_sq, occ);
+    check_squares[QUEEN][color] = check_squares[BISHOP][color] | check_squares[ROOK][color];
+    check_squares[KING][color] = 0ULL;
+
+    state->discoverers[color] = get_blockers(!color, color) & piece_bb(ALL_PIECES, color);
+    state->cached[color] |= CACHED_CHECK_INFO;
 }
 
+// whether a legal move of the side to move checks the opponent, without making it
+bool Position::gives_check(Move move) {
+    int from_square = move.from();
+    int to_square = move.to();
+    int king_sq = king_square(!turn);
+    int piece_type = get_piece_type(piece_on(from_square));
 
-void Position::put_piece(int piece, int square) {
+    if (!move.promote_to() && (check_squares(piece_type) & square_bb(to_square))) {
+        return true;
+    }
+
+    if ((discoverers() & square_bb(from_square)) && !(get_line_bb(from_square, king_sq) & square_bb(to_square))) {
+        return true;
+    }
+
+    uint64_t diagonal = piece_bb(BISHOP, turn) | piece_bb(QUEEN, turn);
+    uint64_t straight = piece_bb(ROOK, turn) | piece_bb(QUEEN, turn);
+    uint64_t occ = (occupancy() ^ square_bb(from_square)) | square_bb(to_square);
+
+    // the promoted piece can see through the square the pawn left
+    if (move.promote_to()) {
+        uint64_t attacks = move.promote_to() == KNIGHT ? get_knight_moves(to_square) :
+                           move.promote_to() == BISHOP ? get_bishop_moves(to_square, occ) :
+                           move.promote_to() == ROOK ? get_rook_moves(to_square, occ) :
+                           get_queen_moves(to_square, occ);
+        return attacks & square_bb(king_sq);
+    }
+
+    // the pawn taken en passant can uncover a slider
+    if (piece_type == PAWN && from_square % 8 != to_square % 8 && !piece_on(to_square)) {
+        occ ^= square_bb((from_square / 8) * 8 + to_square % 8);
+        return (get_bishop_moves(king_sq, occ) & diagonal) || (get_rook_moves(king_sq, occ) & straight);
+    }
+
+    // the castled rook can check
+    if (piece_type == KING && std::abs(from_square % 8 - to_square % 8) > 1) {
+        int rook_start = to_square > from_square ? from_square + 3 : from_square - 4;
+        int rook_end = (from_square + to_square) / 2;
+        occ ^= square_bb(rook_start) | square_bb(rook_end);
+        return get_rook_moves(rook_end, occ) & square_bb(king_sq);
+    }
+
+    return false;
+}
+
+
+inline void Position::put_piece(int piece, int square) {
     int piece_type = get_piece_type(piece);
     int color = get_color(piece);
 
@@ -184,7 +332,7 @@ void Position::put_piece(int piece, int square) {
     }
 }
 
-void Position::remove_piece(int piece, int square) {
+inline void Position::remove_piece(int piece, int square) {
     int piece_type = get_piece_type(piece);
     int color = get_color(piece);
 
@@ -200,13 +348,29 @@ void Position::remove_piece(int piece, int square) {
     }
 }
 
+template<Color Us>
 DirtyPieces Position::make_move(Move move) {
+    constexpr Color them = Us == WHITE ? BLACK : WHITE;
+    constexpr int kingside = Us == WHITE ? WHITE_KINGSIDE : BLACK_KINGSIDE;
+    constexpr int queenside = Us == WHITE ? WHITE_QUEENSIDE : BLACK_QUEENSIDE;
+    constexpr int their_kingside = Us == WHITE ? BLACK_KINGSIDE : WHITE_KINGSIDE;
+    constexpr int their_queenside = Us == WHITE ? BLACK_QUEENSIDE : WHITE_QUEENSIDE;
+    constexpr int kingside_rook = Us == WHITE ? 63 : 7;
+    constexpr int queenside_rook = Us == WHITE ? 56 : 0;
+    constexpr int their_kingside_rook = Us == WHITE ? 7 : 63;
+    constexpr int their_queenside_rook = Us == WHITE ? 0 : 56;
+
     half_moves++;
     if (half_moves >= stack.size()) {
         stack.resize(stack.size() * 2);
     }
-    std::memcpy(&stack[half_moves], state, sizeof(PositionState));
+    std::memcpy(&stack[half_moves], state, offsetof(PositionState, cached));
     state = &stack[half_moves];
+    state->cached[WHITE] = 0;
+    state->cached[BLACK] = 0;
+
+    int& our_material = Us == WHITE ? state->white_material : state->black_material;
+    int& their_material = Us == WHITE ? state->black_material : state->white_material;
 
     int start_square = move.from();
     int end_square = move.to();
@@ -238,28 +402,16 @@ DirtyPieces Position::make_move(Move move) {
         remove_piece(capture, end_square);
 
         int capture_type = get_piece_type(capture);
-        if (turn == WHITE) {
-            state->black_material -= piece_values[capture_type];
-        } else {
-            state->white_material -= piece_values[capture_type];
-        }
+        their_material -= piece_values[capture_type];
 
         // update castle
-        if (capture == WHITE_ROOK) {
-            if (end_square == 63 && (castle_rights() & WHITE_KINGSIDE)) {
-                state->castle_rights &= ~WHITE_KINGSIDE;
-                state->hash_value ^= Zobrist::castle_table[lsb(WHITE_KINGSIDE)];
-            } else if (end_square == 56 && (castle_rights() & WHITE_QUEENSIDE)) {
-                state->castle_rights &= ~WHITE_QUEENSIDE;
-                state->hash_value ^= Zobrist::castle_table[lsb(WHITE_QUEENSIDE)];
-            } 
-        } else if (capture == BLACK_ROOK) {
-            if (end_square == 7 && (castle_rights() & BLACK_KINGSIDE)) {
-                state->castle_rights &= ~BLACK_KINGSIDE;
-                state->hash_value ^= Zobrist::castle_table[lsb(BLACK_KINGSIDE)];
-            } else if (end_square == 0 && (castle_rights() & BLACK_QUEENSIDE)) {
-                state->castle_rights &= ~BLACK_QUEENSIDE;
-                state->hash_value ^= Zobrist::castle_table[lsb(BLACK_QUEENSIDE)];
+        if (capture_type == ROOK) {
+            if (end_square == their_kingside_rook && (castle_rights() & their_kingside)) {
+                state->castle_rights &= ~their_kingside;
+                state->hash_value ^= Zobrist::castle_table[lsb(their_kingside)];
+            } else if (end_square == their_queenside_rook && (castle_rights() & their_queenside)) {
+                state->castle_rights &= ~their_queenside;
+                state->hash_value ^= Zobrist::castle_table[lsb(their_queenside)];
             }
         }
 
@@ -270,15 +422,11 @@ DirtyPieces Position::make_move(Move move) {
 
     remove_piece(piece, start_square);
     int promotion = move.promote_to();
-    int promo_piece = promotion + 1 + (6 * turn);
+    int promo_piece = promotion + 1 + (6 * Us);
     put_piece(promotion ? promo_piece : piece, end_square);
 
     if (promotion) {
-        if (turn == WHITE) {
-            state->white_material += piece_values[promotion] - piece_values[PAWN];
-        } else {
-            state->black_material += piece_values[promotion] - piece_values[PAWN];
-        }
+        our_material += piece_values[promotion] - piece_values[PAWN];
 
         if (capture) {
             type = DIRTY_CAP_PROMO;
@@ -314,15 +462,11 @@ DirtyPieces Position::make_move(Move move) {
 
     } else if (piece_type == PAWN && start_col != end_col && !capture) {
         // en passant
-        int captured_pawn = piece == WHITE_PAWN ? BLACK_PAWN : WHITE_PAWN;
+        constexpr int captured_pawn = Us == WHITE ? BLACK_PAWN : WHITE_PAWN;
         int capture_square = start_row * 8 + end_col;
         remove_piece(captured_pawn, capture_square);
 
-        if (turn == WHITE) {
-            state->black_material -= piece_values[PAWN];
-        } else {
-            state->white_material -= piece_values[PAWN];
-        }
+        their_material -= piece_values[PAWN];
 
         type = DIRTY_EP;
         dps.white_sub1 = NNUE::make_index<WHITE>(capture_square, captured_pawn, white_mirror);
@@ -330,39 +474,22 @@ DirtyPieces Position::make_move(Move move) {
     }
 
     // update castle rights
-    if (piece == WHITE_KING) {
-        if (castle_rights() & WHITE_KINGSIDE) {
-            state->hash_value ^= Zobrist::castle_table[lsb(WHITE_KINGSIDE)];
-        }
-        if (castle_rights() & WHITE_QUEENSIDE) {
-            state->hash_value ^= Zobrist::castle_table[lsb(WHITE_QUEENSIDE)];
+    if (piece_type == KING) {
+        if (castle_rights() & kingside) {
+            state->hash_value ^= Zobrist::castle_table[lsb(kingside)];
         }
-        state->castle_rights &= ~WHITE_KINGSIDE;
-        state->castle_rights &= ~WHITE_QUEENSIDE;
-    } else if (piece == BLACK_KING) {
-        if (castle_rights() & BLACK_KINGSIDE) {
-            state->hash_value ^= Zobrist::castle_table[lsb(BLACK_KINGSIDE)];
+        if (castle_rights() & queenside) {
+            state->hash_value ^= Zobrist::castle_table[lsb(queenside)];
         }
-        if (castle_rights() & BLACK_QUEENSIDE) {
-            state->hash_value ^= Zobrist::castle_table[lsb(BLACK_QUEENSIDE)];
-        }
-        state->castle_rights &= ~BLACK_KINGSIDE;
-        state->castle_rights &= ~BLACK_QUEENSIDE;
-    } else if (piece == WHITE_ROOK) {
-        if (start_square == 63 && (castle_rights() & WHITE_KINGSIDE)) {
-            state->hash_value ^= Zobrist::castle_table[lsb(WHITE_KINGSIDE)];
-            state->castle_rights &= ~WHITE_KINGSIDE;
-        } else if (start_square == 56 && (castle_rights() & WHITE_QUEENSIDE)) {
-            state->hash_value ^= Zobrist::castle_table[lsb(WHITE_QUEENSIDE)];
-            state->castle_rights &= ~WHITE_QUEENSIDE;
-        }
-    } else if (piece == BLACK_ROOK) {
-        if (start_square == 7 && (castle_rights() & BLACK_KINGSIDE)) {
-            state->hash_value ^= Zobrist::castle_table[lsb(BLACK_KINGSIDE)];
-            state->castle_rights &= ~BLACK_KINGSIDE;
-        } else if (start_square == 0 && (castle_rights() & BLACK_QUEENSIDE)) {
-            state->hash_value ^= Zobrist::castle_table[lsb(BLACK_QUEENSIDE)];
-            state->castle_rights &= ~BLACK_QUEENSIDE;
+        state->castle_rights &= ~kingside;
+        state->castle_rights &= ~queenside;
+    } else if (piece_type == ROOK) {
+        if (start_square == kingside_rook && (castle_rights() & kingside)) {
+            state->hash_value ^= Zobrist::castle_table[lsb(kingside)];
+            state->castle_rights &= ~kingside;
+        } else if (start_square == queenside_rook && (castle_rights() & queenside)) {
+            state->hash_value ^= Zobrist::castle_table[lsb(queenside)];
+            state->castle_rights &= ~queenside;
         }
     }
 
@@ -372,17 +499,8 @@ DirtyPieces Position::make_move(Move move) {
     }
     bool en_passant_possible = false;
     if (piece_type == PAWN && std::abs(start_row - end_row) > 1) {
-        if (turn == BLACK) {
-            if ((start_col - 1 >= 0 && piece_on(3 * 8 + start_col - 1) == WHITE_PAWN) ||
-                (start_col + 1 < 8 && piece_on(3 * 8 + start_col + 1) == WHITE_PAWN)) {
-                en_passant_possible = true;
-            }
-        } else {
-            if ((start_col - 1 >= 0 && piece_on(4 * 8 + start_col - 1) == BLACK_PAWN) ||
-                (start_col + 1 < 8 && piece_on(4 * 8 + start_col + 1) == BLACK_PAWN)) {
-                en_passant_possible = true;
-            }
-        }
+        // an enemy pawn beside the pushed pawn
+        en_passant_possible = get_pawn_attacks(end_square + (Us == WHITE ? 8 : -8), Us) & piece_bb(PAWN, them);
     }
     if (en_passant_possible) {
         state->en_passant_col = start_col;
@@ -395,17 +513,21 @@ DirtyPieces Position::make_move(Move move) {
         state->last_threefold_reset = half_moves;
     }
 
-    turn = !turn;
+    turn = them;
     state->hash_value ^= Zobrist::turn_key;
 
-    state->checkers = get_attackers(king_square(turn), !turn, occupancy());
-    state->pinned[turn] = get_pinned(turn);
+    state->checkers = get_attackers(king_square(them), Us, occupancy());
 
     dps.type = type;
     return dps;
 }
 
 
+DirtyPieces Position::make_move(Move move) {
+    return turn == WHITE ? make_move<WHITE>(move) : make_move<BLACK>(move);
+}
+
+
 void Position::pop() {
     state = &stack[--half_moves];
     turn = !turn;
@@ -5,6 +5,7 @@
 #include <string>
 #include <stack>
 #include <cmath>
+#include <cstddef>
 
 #include "types.hh"
 #include "bitboards.hh"
@@ -14,6 +15,14 @@
 #include "nnue/nnue.hh"
 
 
+// which per color attack maps of a PositionState have been computed
+enum AttackCache : int {
+    CACHED_PINNED = 1,
+    CACHED_ATTACKS = 2,
+    CACHED_KING_DANGER = 4,
+    CACHED_CHECK_INFO = 8
+};
+
 struct PositionState {
     // indexed top to bottom, left to right, from white's perspective (a8 is 0)
     uint8_t board[64];
@@ -26,7 +35,6 @@ struct PositionState {
     uint64_t nonpawn_hash[2];
 
     uint64_t checkers;
-    uint64_t pinned[2];
 
     // index in position history of the last irreversable move
     int last_threefold_reset = 0;
@@ -36,6 +44,15 @@ struct PositionState {
     int fifty_move_count;
     int white_material;
     int black_material;
+
+    // per color maps computed on first use at this ply. make_move copies the state only up to
+    // here and clears the flags, pop returns to the parent ply with its maps intact
+    int cached[2];
+    uint64_t pinned[2];
+    uint64_t attacks[7][2];  // squares attacked by piece type and color, ALL_PIECES for all of them
+    uint64_t king_danger[2]; // squares attacked by the other color, seen through this color's king
+    uint64_t check_squares[6][2]; // squares where a piece type of this color would check the other king
+    uint64_t discoverers[2];      // this color's pieces standing between its slider and the other king
 };
 
 
@@ -49,6 +66,10 @@ public:
     void set_keys();
     void set_fen(std::string fen);
     Position(std::string fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+    // state points into the stack, so copies need to re-point it
+    Position(const Position& other);
+    Position& operator=(const Position& other);
     
     static inline int get_color(int piece) {
         return piece > 6;
@@ -87,9 +108,43 @@ public:
     }
 
     uint64_t pinned() {
+        if (!(state->cached[turn] & CACHED_PINNED)) {
+            state->pinned[turn] = get_pinned(turn);
+            state->cached[turn] |= CACHED_PINNED;
+        }
         return state->pinned[turn];
     }
 
+    uint64_t attacks(int piece_type, int color) {
+        if (!(state->cached[color] & CACHED_ATTACKS)) {
+            set_attacks(color);
+        }
+        return state->attacks[piece_type][color];
+    }
+
+    // squares the side to move's king can't step to
+    uint64_t king_danger() {
+        if (!(state->cached[turn] & CACHED_KING_DANGER)) {
+            state->king_danger[turn] = get_king_danger(turn);
+            state->cached[turn] |= CACHED_KING_DANGER;
+        }
+        return state->king_danger[turn];
+    }
+
+    uint64_t check_squares(int piece_type) {
+        if (!(state->cached[turn] & CACHED_CHECK_INFO)) {
+            set_check_info(turn);
+        }
+        return state->check_squares[piece_type][turn];
+    }
+
+    uint64_t discoverers() {
+        if (!(state->cached[turn] & CACHED_CHECK_INFO)) {
+            set_check_info(turn);
+        }
+        return state->discoverers[turn];
+    }
+
     int castle_rights() {
         return state->castle_rights;
     }
@@ -109,11 +164,17 @@ public:
 
     uint64_t get_attackers(int square, int color, uint64_t blockers);
     bool is_attacked(int square);
+    uint64_t get_blockers(int king_color, int slider_color);
     uint64_t get_pinned(int color);
+    uint64_t get_king_danger(int color);
+    void set_attacks(int color);
+    void set_check_info(int color);
+    bool gives_check(Move move);
 
     void put_piece(int piece, int square);
     void remove_piece(int piece, int square);
     DirtyPieces make_move(Move move);
+    template<Color Us> DirtyPieces make_move(Move move);
     void pop();
 
     bool SEE(Move move, int threshold = 0);
@@ -0,0 +1,70 @@
+#include "profiler.hh"
+
+#include <cstdio>
+
+#if defined(__linux__)
+#include <signal.h>
+#include <sys/time.h>
+#endif
+
+namespace Profiler {
+    thread_local volatile Subsystem current = SEARCH;
+
+    static std::atomic<uint64_t> samples[NUM_SUBSYSTEMS];
+
+    static const char* names[NUM_SUBSYSTEMS] = {
+        "search", "movegen", "movepick", "legality", "make/unmake", "eval", "tt"
+    };
+
+#if defined(__linux__)
+    static void on_sample(int) {
+        samples[current].fetch_add(1, std::memory_order_relaxed);
+    }
+#endif
+
+    void start(int interval) {
+    #if defined(__linux__)
+        struct sigaction action = {};
+        action.sa_handler = on_sample;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+
+        struct itimerval timer = {};
+        timer.it_interval.tv_sec = interval / 1000000;
+        timer.it_interval.tv_usec = interval % 1000000;
+        timer.it_value = timer.it_interval;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+    #endif
+    }
+
+    void stop() {
+    #if defined(__linux__)
+        struct itimerval timer = {};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        signal(SIGPROF, SIG_IGN);
+    #endif
+    }
+
+    void clear() {
+        for (auto& count : samples) {
+            count.store(0);
+        }
+    }
+
+    void print() {
+        uint64_t total = 0;
+        for (auto& count : samples) {
+            total += count.load();
+        }
+
+        printf("profile: %llu samples\n", total);
+        if (!total) {
+            return;
+        }
+        for (int i = 0; i < NUM_SUBSYSTEMS; i++) {
+            uint64_t count = samples[i].load();
+            printf("%-12s %5.1f%%  (%llu)\n", names[i], 100.0 * count / total, count);
+        }
+    }
+};
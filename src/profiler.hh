@@ -0,0 +1,52 @@
+#ifndef profiler_hh
+#define profiler_hh
+
+#include <atomic>
+#include <cstdint>
+
+// sampling profiler: a SIGPROF timer interrupts whichever thread is using cpu,
+// and the handler counts the subsystem that thread marked as current.
+// markers are compiled in with make PROFILE=1, otherwise PROFILE_SCOPE does nothing
+namespace Profiler {
+    enum Subsystem {
+        SEARCH,    // negamax/quiescense bodies and anything unmarked
+        MOVEGEN,   // pseudo-legal move generation
+        MOVEPICK,  // move scoring, selection and SEE
+        LEGALITY,  // is_legal and is_pseudo_legal
+        MAKE_MOVE, // make/unmake, including accumulator refreshes on king moves
+        EVAL,      // eval cache, accumulator updates and nnue inference
+        TT,        // transposition table probes and stores
+        NUM_SUBSYSTEMS
+    };
+
+    extern thread_local volatile Subsystem current;
+
+    // marks the enclosing scope and restores the outer subsystem when it ends
+    struct Scope {
+        Subsystem previous;
+
+        Scope(Subsystem subsystem) : previous(current) {
+            current = subsystem;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+
+        ~Scope() {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            current = previous;
+        }
+    };
+
+    // interval is in microseconds of cpu time summed over all threads
+    void start(int interval = 1000);
+    void stop();
+    void clear();
+    void print();
+};
+
+#ifdef SEARCH_PROFILE
+#define PROFILE_SCOPE(subsystem) Profiler::Scope profile_scope(Profiler::subsystem)
+#else
+#define PROFILE_SCOPE(subsystem)
+#endif
+
+#endif
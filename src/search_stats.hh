@@ -0,0 +1,99 @@
+#ifndef search_stats_hh
+#define search_stats_hh
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "types.hh"
+
+// search statistics for tuning pruning parameters. compiled in with make STATS=1,
+// otherwise every STAT() expression disappears and the search is unchanged
+#ifdef SEARCH_STATS
+#define STAT(expr) (expr)
+#else
+#define STAT(expr)
+#endif
+
+struct SearchStats {
+    // completed negamax nodes by remaining depth and the bound they stored
+    uint64_t pv_nodes[MAX_DEPTH];
+    uint64_t cut_nodes[MAX_DEPTH];
+    uint64_t all_nodes[MAX_DEPTH];
+    uint64_t qsearch_nodes;
+
+    uint64_t tt_cutoffs;
+    uint64_t qsearch_tt_cutoffs;
+
+    uint64_t rfp_prunes;
+    uint64_t null_move_searches;
+    uint64_t null_move_cutoffs;
+
+    // lmp and futility pruning skip the rest of the quiet moves at once
+    uint64_t lmp_prunes;
+    uint64_t futility_prunes;
+    uint64_t capture_futility_prunes;
+    uint64_t see_prunes;
+
+    uint64_t singular_searches;
+    uint64_t singular_extensions;
+    uint64_t multicut_cutoffs;
+
+    uint64_t lmr_searches;
+    uint64_t lmr_researches;
+
+    // beta cutoffs in the move loop, and how many came from the first move searched
+    uint64_t beta_cutoffs;
+    uint64_t first_move_cutoffs;
+
+    SearchStats() {
+        clear();
+    }
+
+    void clear() {
+        std::memset(this, 0, sizeof(SearchStats));
+    }
+
+    void add(const SearchStats& other) {
+        const uint64_t* src = reinterpret_cast<const uint64_t*>(&other);
+        uint64_t* dst = reinterpret_cast<uint64_t*>(this);
+        for (size_t i = 0; i < sizeof(SearchStats) / sizeof(uint64_t); i++) {
+            dst[i] += src[i];
+        }
+    }
+
+    static double percent(uint64_t part, uint64_t total) {
+        return total ? 100.0 * part / total : 0.0;
+    }
+
+    void print() const {
+        uint64_t total_pv = 0, total_cut = 0, total_all = 0;
+        printf("depth %12s %12s %12s\n", "pv", "cut", "all");
+        for (int depth = 0; depth < MAX_DEPTH; depth++) {
+            if (pv_nodes[depth] || cut_nodes[depth] || all_nodes[depth]) {
+                printf("%5d %12llu %12llu %12llu\n", depth, pv_nodes[depth], cut_nodes[depth], all_nodes[depth]);
+            }
+            total_pv += pv_nodes[depth];
+            total_cut += cut_nodes[depth];
+            total_all += all_nodes[depth];
+        }
+        printf("total %12llu %12llu %12llu\n", total_pv, total_cut, total_all);
+        printf("qsearch nodes: %llu\n", qsearch_nodes);
+
+        printf("tt cutoffs: %llu (qsearch %llu)\n", tt_cutoffs, qsearch_tt_cutoffs);
+        printf("rfp prunes: %llu\n", rfp_prunes);
+        printf("null move cutoffs: %llu / %llu (%.1f%%)\n",
+            null_move_cutoffs, null_move_searches, percent(null_move_cutoffs, null_move_searches));
+        printf("lmp prunes: %llu\n", lmp_prunes);
+        printf("futility prunes: %llu (captures %llu)\n", futility_prunes, capture_futility_prunes);
+        printf("see prunes: %llu\n", see_prunes);
+        printf("singular extensions: %llu / %llu (%.1f%%), multicut: %llu\n",
+            singular_extensions, singular_searches, percent(singular_extensions, singular_searches), multicut_cutoffs);
+        printf("lmr re-searches: %llu / %llu (%.1f%%)\n",
+            lmr_researches, lmr_searches, percent(lmr_researches, lmr_searches));
+        printf("first move cutoffs: %llu / %llu (%.1f%%)\n",
+            first_move_cutoffs, beta_cutoffs, percent(first_move_cutoffs, beta_cutoffs));
+    }
+};
+
+#endif
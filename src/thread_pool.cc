@@ -0,0 +1,182 @@
+#include "thread_pool.hh"
+
+SearchThread::SearchThread(ThreadPool& pool, int id) : pool(pool), id(id), thread(&SearchThread::idle_loop, this) {
+    // wait for the engine to be allocated
+    wait_for_search_finished();
+}
+
+SearchThread::~SearchThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exit = true;
+        searching = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void SearchThread::start_searching() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        searching = true;
+    }
+    cv.notify_all();
+}
+
+void SearchThread::wait_for_search_finished() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return !searching; });
+}
+
+void SearchThread::idle_loop() {
+    int node = Numa::node_for_thread(id);
+    if (node >= 0) {
+        Numa::bind_thread(node);
+    }
+
+    // allocate search state from the thread that uses it so it lands on the thread's node
+    engine = std::make_unique<Engine>();
+    if (pool.eval_cache_size != Engine::EvalCacheSize) {
+        engine->eval_cache.resize(pool.eval_cache_size);
+    }
+
+    if (node >= 0) {
+        NNUE::use_numa_replica(node);
+    }
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        searching = false;
+        cv.notify_all();
+        cv.wait(lock, [this] { return searching; });
+
+        if (exit) {
+            return;
+        }
+
+        lock.unlock();
+        search();
+    }
+}
+
+void SearchThread::search() {
+    if (id != 0) {
+        engine->get_move(position, info);
+        return;
+    }
+
+    for (size_t i = 1; i < pool.size(); i++) {
+        pool.threads[i]->start_searching();
+    }
+
+    Move best_move = engine->get_move(position, info);
+
+    // bestmove can't be sent while pondering, even if the search finished early
+    while (pool.pondering.load() && !pool.stop_search.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // helpers search until the main thread is done
+    pool.stop_search.store(true);
+    for (size_t i = 1; i < pool.size(); i++) {
+        pool.threads[i]->wait_for_search_finished();
+    }
+
+    pool.best_move = best_move;
+    pool.ponder_move = engine->get_ponder_move(position, best_move);
+    if (info.uci) {
+        if (pool.ponder_move) {
+            printf("bestmove %s ponder %s\n", best_move.to_uci().c_str(), pool.ponder_move.to_uci().c_str());
+        } else {
+            printf("bestmove %s\n", best_move.to_uci().c_str());
+        }
+        fflush(stdout);
+    }
+}
+
+
+ThreadPool::~ThreadPool() {
+    stop();
+    set(0);
+}
+
+// threads are created sequentially since each engine initializes shared nnue weights
+void ThreadPool::set(size_t num_threads) {
+    if (num_threads == size()) {
+        return;
+    }
+
+    if (size()) {
+        wait_for_search_finished();
+    }
+
+    while (size() > num_threads) {
+        threads.pop_back();
+    }
+    while (size() < num_threads) {
+        threads.push_back(std::make_unique<SearchThread>(*this, size()));
+    }
+}
+
+void ThreadPool::set_eval_cache(int megabytes) {
+    eval_cache_size = megabytes;
+    wait_for_search_finished();
+    for (auto& th : threads) {
+        th->engine->eval_cache.resize(megabytes);
+    }
+}
+
+void ThreadPool::clear() {
+    wait_for_search_finished();
+    for (auto& th : threads) {
+        th->engine->init();
+    }
+}
+
+void ThreadPool::start_thinking(Position& position, SearchInfo info) {
+    wait_for_search_finished();
+    stop_search.store(false);
+    pondering.store(info.ponder);
+
+    info.stop_search = &stop_search;
+    info.pondering = &pondering;
+    info.nodes_searched = [this] { return nodes_searched(); };
+
+    // helpers ignore time and node limits and are stopped by the main thread
+    SearchInfo helper_info;
+    helper_info.fixed_depth = true;
+    helper_info.depth = info.fixed_depth ? info.depth : MAX_DEPTH;
+    helper_info.stop_search = &stop_search;
+
+    for (auto& th : threads) {
+        th->position = position;
+        th->info = th->id == 0 ? info : helper_info;
+    }
+
+    main()->start_searching();
+}
+
+void ThreadPool::stop() {
+    stop_search.store(true);
+    wait_for_search_finished();
+}
+
+// the opponent played the expected move: continue the same search under normal time limits
+void ThreadPool::ponderhit() {
+    pondering.store(false);
+    main()->engine->timer.ponderhit();
+}
+
+uint64_t ThreadPool::nodes_searched() {
+    uint64_t nodes = 0;
+    for (auto& th : threads) {
+        nodes += th->engine->total_nodes;
+    }
+    return nodes;
+}
+
+void ThreadPool::wait_for_search_finished() {
+    if (size()) {
+        main()->wait_for_search_finished();
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef thread_pool_hh
+#define thread_pool_hh
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "engine.hh"
+#include "position.hh"
+#include "move.hh"
+#include "types.hh"
+#include "numa.hh"
+
+class ThreadPool;
+
+// search thread that is created once and parked on a condition variable between searches.
+// thread 0 is the main thread: it reports the search and stops the helpers,
+// which search the same position to fill the shared transposition table (lazy smp)
+class SearchThread {
+    ThreadPool& pool;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool searching = true;
+    bool exit = false;
+
+    void idle_loop();
+    void search();
+
+public:
+    int id;
+    std::unique_ptr<Engine> engine;
+    Position position;
+    SearchInfo info;
+
+    // started last so the thread sees every other member initialized
+    std::thread thread;
+
+    SearchThread(ThreadPool& pool, int id);
+    ~SearchThread();
+
+    void start_searching();
+    void wait_for_search_finished();
+};
+
+class ThreadPool {
+public:
+    std::vector<std::unique_ptr<SearchThread>> threads;
+    std::atomic<bool> stop_search = false;
+    std::atomic<bool> pondering = false;
+
+    int eval_cache_size = Engine::EvalCacheSize;
+    Move best_move;
+    Move ponder_move;
+
+    ~ThreadPool();
+
+    SearchThread* main() {
+        return threads[0].get();
+    }
+
+    size_t size() {
+        return threads.size();
+    }
+
+    uint64_t nodes_searched();
+
+    void set(size_t num_threads);
+    void set_eval_cache(int megabytes);
+    void clear();
+
+    void start_thinking(Position& position, SearchInfo info);
+    void stop();
+    void ponderhit();
+    void wait_for_search_finished();
+};
+
+#endif
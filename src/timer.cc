@@ -0,0 +1,81 @@
+#include "timer.hh"
+
+Timer::~Timer() {
+    if (thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            exit = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+}
+
+void Timer::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!exit) {
+        if (!armed || waiting_for_ponderhit) {
+            cv.wait(lock);
+            continue;
+        }
+
+        cv.wait_until(lock, deadline);
+        if (armed && !waiting_for_ponderhit && clock::now() >= deadline) {
+            stop->store(true, std::memory_order_relaxed);
+            armed = false;
+            fired = true;
+        }
+    }
+}
+
+void Timer::arm(int milliseconds, std::atomic<bool>* stop_flag, std::atomic<bool>* pondering_flag) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!thread.joinable()) {
+            thread = std::thread(&Timer::loop, this);
+        }
+
+        stop = stop_flag;
+        pondering = pondering_flag;
+        duration = std::chrono::milliseconds(milliseconds);
+        start = clock::now();
+        deadline = start + duration;
+        waiting_for_ponderhit = pondering && pondering->load();
+        armed = true;
+        fired = false;
+    }
+    cv.notify_all();
+}
+
+void Timer::disarm() {
+    std::lock_guard<std::mutex> lock(mutex);
+    armed = false;
+}
+
+// called after the pondering flag is cleared
+void Timer::ponderhit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!armed || !waiting_for_ponderhit) {
+            return;
+        }
+
+        start = clock::now();
+        deadline = start + duration;
+        waiting_for_ponderhit = false;
+    }
+    cv.notify_all();
+}
+
+int Timer::elapsed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+}
+
+int Timer::stop_latency_us() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fired) {
+        return -1;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - deadline).count();
+}
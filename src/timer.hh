@@ -0,0 +1,48 @@
+#ifndef timer_hh
+#define timer_hh
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+// watchdog that sets a stop flag at a hard deadline, so the search only has to load the flag.
+// the thread is created on first use and sleeps between searches
+class Timer {
+    using clock = std::chrono::steady_clock;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    bool exit = false;
+    bool armed = false;
+    bool fired = false;
+
+    // while pondering the clock doesn't run until ponderhit
+    bool waiting_for_ponderhit = false;
+    std::atomic<bool>* pondering = nullptr;
+
+    std::atomic<bool>* stop = nullptr;
+    clock::duration duration;
+    clock::time_point start;
+    clock::time_point deadline;
+
+    void loop();
+
+public:
+    ~Timer();
+
+    void arm(int milliseconds, std::atomic<bool>* stop, std::atomic<bool>* pondering = nullptr);
+    void disarm();
+    void ponderhit();
+
+    // time since the clock started, in milliseconds
+    int elapsed();
+
+    // how long after the deadline the search noticed the stop, or -1 if the timer didn't fire
+    int stop_latency_us();
+};
+
+#endif
@@ -7,6 +7,8 @@
 
 #include "move.hh"
 #include "types.hh"
+#include "numa.hh"
+#include "profiler.hh"
 
 class TranspositionTable {
     TTEntry* table = nullptr;
@@ -37,6 +39,7 @@ public:
     }
 
     void insert(uint64_t key, int16_t value, int16_t static_eval, uint16_t best_move, TTBound type, int8_t depth) {
+        PROFILE_SCOPE(TT);
         const uint64_t index = get_index(key);
         TTEntry& current = table[index];
         uint16_t key16 = uint16_t(key);
@@ -58,6 +61,7 @@ public:
     }
 
     bool get(uint64_t key, TTEntry& entry) {
+        PROFILE_SCOPE(TT);
         const uint64_t index = get_index(key);
         const TTEntry& candidate = table[index];
 
@@ -77,9 +81,11 @@ public:
             free(table);
         }
 
-        size_t bytes = megabytes * 1024 * 1024;
+        // page aligned so pages can be interleaved across numa nodes before they are touched
+        size_t bytes = size_t(megabytes) * 1024 * 1024;
         size = bytes / sizeof(TTEntry);
-        table = (TTEntry *) malloc(bytes);
+        table = (TTEntry *) std::aligned_alloc(4096, bytes);
+        Numa::interleave(table, bytes);
         clear();
     }
 };
@@ -3,6 +3,8 @@
 
 #include <chrono>
 #include <atomic>
+#include <functional>
+#include <cstdint>
 
 #define INF 1000000000
 
@@ -23,7 +25,7 @@ struct SearchInfo {
     int movetime = 0;
 
     int depth = 0;
-    int nodes = 0;
+    uint64_t nodes = 0;
 
     bool uci = false;
 
@@ -38,6 +40,35 @@ struct SearchInfo {
 
     bool verbose = false;
     std::atomic<bool>* stop_search = nullptr;
+
+    // go ponder: search without time limits until ponderhit clears the flag
+    bool ponder = false;
+    std::atomic<bool>* pondering = nullptr;
+
+    // Ponder option: the opponent's time will also be used, so plan more time per move
+    bool ponder_enabled = false;
+
+    // nodes searched by every thread, for info output and node limits.
+    // only called every few thousand nodes since it reads other threads' counters
+    std::function<uint64_t()> nodes_searched;
+};
+
+// node count that is only written by its own thread, so increments don't need a locked instruction.
+// it gets a cache line to itself so threads reading it don't slow down the thread writing it
+struct alignas(64) NodeCounter {
+    std::atomic<uint64_t> count = 0;
+
+    void operator++(int) {
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void operator=(uint64_t value) {
+        count.store(value, std::memory_order_relaxed);
+    }
+
+    operator uint64_t() const {
+        return count.load(std::memory_order_relaxed);
+    }
 };
 
 static int piece_values[6] = { 100, 313, 339, 546, 944, 0 };
@@ -95,8 +126,6 @@ enum TerminalState {
     INSUFFICIENT_MATERIAL = 6
 };
 
-constexpr int TT_DEPTH_UNSEARCHED = -1;
-
 enum TTBound : uint8_t {
     EXACT_BOUND,
     LOWER_BOUND,
@@ -2,22 +2,26 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
-#include <thread>
-#include <atomic>
 
 #include "position.hh"
 #include "engine.hh"
+#include "thread_pool.hh"
 #include "move.hh"
 #include "movegen.hh"
+#include "init.hh"
 
 // executable to interact with tools like fastchess, GUIs, etc.
 
 int main(int argc, char * argv[]) {
-    Engine engine;
+    init_all();
+    ThreadPool threads;
     Position position;
 
-    std::thread search_thread;
-    std::atomic<bool> stop_search(false);
+    // search threads are started on isready or when the thread count is set,
+    // and are reused for every search after that
+    int num_threads = 1;
+    int hash_size = Engine::Hash;
+    bool ponder_enabled = false;
 
     std::string line;
     while (std::getline(std::cin, line)) {
@@ -25,7 +29,11 @@ int main(int argc, char * argv[]) {
             printf("id name Shmembot\n");
             printf("id author Ryan Hirsch\n");
 
-            printf("option name Hash type spin default %d min 1 max 1048576\n", engine.Hash);
+            printf("option name Hash type spin default %d min 1 max 1048576\n", Engine::Hash);
+            printf("option name EvalCache type spin default %d min 1 max 1024\n", Engine::EvalCacheSize);
+            printf("option name Threads type spin default 1 min 1 max 1024\n");
+            printf("option name Ponder type check default false\n");
+            printf("option name NumaPolicy type combo default auto var auto var none\n");
 
             printf("uciok\n");
         } else if (line.rfind("setoption", 0) == 0) {
@@ -43,15 +51,40 @@ int main(int argc, char * argv[]) {
             }
 
             if (name == "Hash") {
-                int hash = std::stoi(value);
-                hash = std::max(hash, 1);
-                hash = std::min(hash, 1048576);
-                engine.transposition_table.resize(hash);
+                hash_size = std::stoi(value);
+                hash_size = std::max(hash_size, 1);
+                hash_size = std::min(hash_size, 1048576);
+                threads.wait_for_search_finished();
+                Engine::shared_transposition_table().resize(hash_size);
+            } else if (name == "EvalCache") {
+                int size = std::stoi(value);
+                size = std::max(size, 1);
+                size = std::min(size, 1024);
+                threads.set_eval_cache(size);
+            } else if (name == "Threads") {
+                num_threads = std::stoi(value);
+                num_threads = std::max(num_threads, 1);
+                num_threads = std::min(num_threads, 1024);
+                threads.set(num_threads);
+            } else if (name == "Ponder") {
+                ponder_enabled = value == "true";
+            } else if (name == "NumaPolicy") {
+                Numa::policy = Numa::policy_from_string(value);
+
+                // re-place threads, network replicas and the transposition table
+                if (threads.size()) {
+                    threads.set(0);
+                    threads.set(num_threads);
+                }
+                Engine::shared_transposition_table().resize(hash_size);
             }
         } else if (line == "isready") {
+            threads.set(num_threads);
             printf("readyok\n");
+            fflush(stdout);
         } else if (line == "ucinewgame") {
-            engine.init();
+            threads.set(num_threads);
+            threads.clear();
         } else if (line.rfind("position", 0) == 0) {
             std::istringstream iss(line);
             std::string token;
@@ -82,21 +115,21 @@ int main(int argc, char * argv[]) {
             iss >> arg;
             iss >> arg;
             int depth = std::stoi(arg);
-            printf("%llu\n", bulk_perft(position, depth));
+            printf("%llu\n", parallel_perft(position, depth, num_threads, hash_size));
         } else if (line.rfind("go", 0) == 0) {
-            if (search_thread.joinable()) {
-                stop_search.store(true);
-                search_thread.join();
-            }
-            stop_search.store(false);
+            threads.stop();
+            threads.set(num_threads);
 
-            int depth = 0, nodes = 0, movetime = 0, wtime = 0, btime = 0, winc = 0, binc = 0;
+            int depth = 0, movetime = 0, wtime = 0, btime = 0, winc = 0, binc = 0;
+            uint64_t nodes = 0;
+            bool ponder = false;
 
             std::istringstream iss(line);
             std::string token;
             iss >> token;
             while (iss >> token) {
                 if (token == "infinite") depth = MAX_DEPTH;
+                else if (token == "ponder") ponder = true;
                 else if (token == "depth") iss >> depth;
                 else if (token == "nodes") iss >> nodes;
                 else if (token == "movetime") iss >> movetime;
@@ -127,24 +160,17 @@ int main(int argc, char * argv[]) {
                 }
             }
             info.uci = true;
-            info.stop_search = &stop_search;
-
-            search_thread = std::thread([&engine, &position, &info]() {
-                Move best_move = engine.get_move(position, info);
-                printf("bestmove %s\n", best_move.to_uci().c_str());
-                fflush(stdout);
-            });
-            
+            info.ponder = ponder;
+            info.ponder_enabled = ponder_enabled;
+
+            threads.start_thinking(position, info);
+
+        } else if (line == "ponderhit") {
+            threads.ponderhit();
         } else if (line == "stop") {
-            stop_search.store(true);
-            if (search_thread.joinable()) {
-                search_thread.join();
-            }
+            threads.stop();
         } else if (line == "quit") {
-            stop_search.store(true);
-            if (search_thread.joinable()) {
-                search_thread.join();
-            }
+            threads.stop();
             break;
         }
     }
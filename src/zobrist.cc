@@ -15,6 +15,9 @@ namespace Zobrist {
     }
 
     void init() {
+        // the keys must come out the same each time, so books and hash dumps stay valid
+        seed = 314159265;
+
         for (int i = 0; i < 12; i++) {
             for (int j = 0; j < 64; j++) {
                 piece_table[i][j] = random_u64();